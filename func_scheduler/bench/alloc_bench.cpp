@@ -0,0 +1,89 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+#include "func_scheduler.hpp"
+
+namespace {
+
+using clock_type = dts::func_scheduler::clock_type;
+
+std::atomic<std::size_t> alloc_cnt(0);
+
+constexpr std::size_t round_cnt = 100;
+constexpr std::size_t round_size = 2'000;
+
+// Schedules round_cnt rounds of round_size functions due 5ms to 6ms later,
+// each one while the previous round fires, and prints the heap allocations
+// per function and the time run_after() takes per function.
+template<typename Scheduler>
+void bench_churn(const char* name) {
+    Scheduler fs(2);
+    std::atomic<std::size_t> done(0);
+    clock_type::duration scheduling(0);
+    auto schedule_round = [&fs, &done, &scheduling] {
+        const auto before = clock_type::now();
+        for (std::size_t i = 0; i < round_size; ++i) {
+            fs.run_after(std::chrono::microseconds(5'000 + i % 1000), [&done] {
+                done.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+        scheduling += clock_type::now() - before;
+    };
+    auto wait_for = [&done](std::size_t cnt) {
+        while (done.load() < cnt) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    };
+    // Warms up the pools and the store.
+    schedule_round();
+    wait_for(round_size);
+    done = 0;
+    scheduling = clock_type::duration(0);
+    const std::size_t allocs_before = alloc_cnt.load();
+    for (std::size_t r = 0; r < round_cnt; ++r) {
+        schedule_round();
+        wait_for(r * round_size);
+    }
+    fs.wait();
+    const std::size_t job_cnt = round_cnt * round_size;
+    const std::chrono::duration<double, std::nano> per_job =
+      scheduling / job_cnt;
+    std::printf("%22s %12.2f %16.1f\n", name,
+                double(alloc_cnt.load() - allocs_before) / job_cnt,
+                per_job.count());
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+    alloc_cnt.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+int main() {
+    std::printf("%zu functions scheduled as earlier ones fire, on 2 workers\n",
+                round_cnt * round_size);
+    std::printf("%22s %12s %16s\n", "store", "allocs/job",
+                "run_after (ns)");
+    bench_churn<dts::basic_func_scheduler<dts::func_info_map>>(
+      "func_info_map");
+    bench_churn<dts::func_scheduler>("pooled_func_info_map");
+    bench_churn<dts::wheel_func_scheduler>("timing_wheel");
+
+    return 0;
+}
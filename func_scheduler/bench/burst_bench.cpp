@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "func_scheduler.hpp"
+#include "thread_pool.hpp"
+
+using dts::func_scheduler;
+
+namespace {
+
+using clock_type = func_scheduler::clock_type;
+
+constexpr std::size_t job_cnt = 200'000;
+constexpr std::size_t insert_cnt = 50'000;
+
+// Schedules job_cnt functions due at the same instant and returns how many
+// of them run per second, from that instant until the last one is done.
+double bench_burst(func_scheduler& fs) {
+    std::atomic<std::size_t> done(0);
+    std::atomic<clock_type::rep> last_done(0);
+    const auto when = clock_type::now() + std::chrono::milliseconds(500);
+    for (std::size_t i = 0; i < job_cnt; ++i) {
+        fs.run_at(when, [&done, &last_done] {
+            if (done.fetch_add(1, std::memory_order_acq_rel) + 1 == job_cnt) {
+                last_done.store(clock_type::now().time_since_epoch().count());
+            }
+        });
+    }
+    fs.wait();
+    const std::chrono::duration<double> elapsed =
+      clock_type::duration(last_done.load()) - when.time_since_epoch();
+    return job_cnt / elapsed.count();
+}
+
+// Returns the cost in ns per timer of scheduling insert_cnt timers spread
+// over a second, one by one or in a single batch.
+double bench_insert(bool bulk) {
+    func_scheduler fs(1);
+    const auto start = clock_type::now() + std::chrono::hours(1);
+    const auto step =
+      std::chrono::nanoseconds(std::chrono::seconds(1)) / insert_cnt;
+    std::vector<std::pair<clock_type::time_point, std::function<void()>>>
+      timers;
+    timers.reserve(insert_cnt);
+    for (std::size_t i = 0; i < insert_cnt; ++i) {
+        timers.emplace_back(start + step * i, [] {});
+    }
+    std::vector<func_scheduler::handle<void>> handles;
+    handles.reserve(insert_cnt);
+    const auto before = clock_type::now();
+    if (bulk) {
+        handles = fs.run_at_bulk(timers.begin(), timers.end());
+    }
+    else {
+        for (auto& [when, fn] : timers) {
+            handles.push_back(fs.run_at(when, fn));
+        }
+    }
+    const std::chrono::duration<double, std::nano> elapsed =
+      clock_type::now() - before;
+    for (auto& h : handles) {
+        h.cancel();
+    }
+    return elapsed.count() / insert_cnt;
+}
+
+}  // namespace
+
+int main() {
+    const std::size_t max_worker_cnt =
+      std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::size_t> worker_cnts;
+    for (std::size_t n = 1; n < max_worker_cnt; n <<= 1) {
+        worker_cnts.push_back(n);
+    }
+    worker_cnts.push_back(max_worker_cnt);
+
+    std::printf("%zu functions due at once, throughput in Mjobs/s\n",
+                job_cnt);
+    std::printf("%8s %14s %14s\n", "workers", "own workers", "thread_pool");
+    for (std::size_t n : worker_cnts) {
+        double own;
+        {
+            func_scheduler fs(n);
+            own = bench_burst(fs);
+        }
+        double pooled;
+        {
+            dts::thread_pool pool(n);
+            func_scheduler fs(pool);
+            pooled = bench_burst(fs);
+        }
+        std::printf("%8zu %14.3f %14.3f\n", n, own / 1e6, pooled / 1e6);
+    }
+
+    std::printf("\nscheduling %zu timers, ns per timer\n", insert_cnt);
+    std::printf("%10s %12s\n", "run_at", "run_at_bulk");
+    const double one_by_one = bench_insert(false);
+    const double bulk = bench_insert(true);
+    std::printf("%10.1f %12.1f\n", one_by_one, bulk);
+
+    return 0;
+}
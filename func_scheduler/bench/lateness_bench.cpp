@@ -0,0 +1,53 @@
+#include <chrono>
+#include <cstdio>
+
+#include "func_scheduler.hpp"
+
+using dts::func_scheduler;
+
+namespace {
+
+using clock_type = func_scheduler::clock_type;
+
+constexpr long timer_cnt = 20'000;
+
+// Spreads timer_cnt timers evenly over span and prints func_scheduler's own
+// account of how late they started, waiting for a worker included.
+void bench_lateness(std::chrono::nanoseconds span) {
+    dts::func_scheduler_stats stats;
+    {
+        func_scheduler fs(2);
+        const auto start = clock_type::now() + std::chrono::milliseconds(200);
+        const auto step = span / timer_cnt;
+        for (long i = 0; i < timer_cnt; ++i) {
+            fs.run_at(start + step * i, [] {});
+        }
+        fs.wait();
+        stats = fs.stats();
+    }
+    std::printf("%14.0f %12.1f %12.1f %12.1f %12llu %12.1f\n",
+                timer_cnt / std::chrono::duration<double>(span).count(),
+                stats.lateness.percentile(50).count() / 1e3,
+                stats.lateness.percentile(99).count() / 1e3,
+                stats.lateness.percentile(99.9).count() / 1e3,
+                static_cast<unsigned long long>(
+                  stats.queue_depth.percentile(50)),
+                stats.busy_time.count() / 1e3);
+}
+
+}  // namespace
+
+int main() {
+#if !DTS_FUNC_SCHEDULER_STATS
+    std::printf("Built without DTS_FUNC_SCHEDULER_STATS\n");
+    return 1;
+#endif
+    std::printf("%ld timers on 2 workers, times in us\n", timer_cnt);
+    std::printf("%14s %12s %12s %12s %12s %12s\n", "timers/s", "p50 late",
+                "p99 late", "p99.9 late", "p50 depth", "busy");
+    for (long ms : { 10'000, 1'000, 100, 10 }) {
+        bench_lateness(std::chrono::milliseconds(ms));
+    }
+
+    return 0;
+}
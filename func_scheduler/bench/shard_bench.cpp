@@ -0,0 +1,65 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "func_scheduler.hpp"
+
+using dts::func_scheduler;
+
+namespace {
+
+using clock_type = func_scheduler::clock_type;
+
+constexpr std::size_t timer_cnt = 400'000;
+// Fixed, so that results compare across machines.
+constexpr std::size_t sharded_cnt = 8;
+
+// Schedules timer_cnt timers, due within the next 100ms, from producer_cnt
+// threads at once and returns how many are scheduled per second.
+double bench_producers(std::size_t producer_cnt, std::size_t shard_cnt) {
+    dts::func_scheduler_options options;
+    options.shards = shard_cnt;
+    func_scheduler fs(2, options);
+    std::atomic<bool> go(false);
+    std::atomic<std::size_t> ran(0);
+    std::vector<std::thread> producers;
+    for (std::size_t p = 0; p < producer_cnt; ++p) {
+        producers.emplace_back([&, p] {
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+            for (std::size_t i = p; i < timer_cnt; i += producer_cnt) {
+                const auto delay =
+                  std::chrono::microseconds(1'000 + i % 100'000);
+                fs.run_after(delay, [&ran] {
+                    ran.fetch_add(1, std::memory_order_relaxed);
+                });
+            }
+        });
+    }
+    const auto start = clock_type::now();
+    go = true;
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    const std::chrono::duration<double> elapsed = clock_type::now() - start;
+    fs.wait();
+    return timer_cnt / elapsed.count();
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%zu timers scheduled, Mtimers/s, %zu shards when sharded\n",
+                timer_cnt, sharded_cnt);
+    std::printf("%10s %12s %12s\n", "producers", "1 shard", "sharded");
+    for (std::size_t n = 1; n <= 64; n <<= 1) {
+        const double single = bench_producers(n, 1);
+        const double sharded = bench_producers(n, sharded_cnt);
+        std::printf("%10zu %12.3f %12.3f\n", n, single / 1e6, sharded / 1e6);
+    }
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include "func_scheduler.hpp"
+#include "latency_histogram.hpp"
+
+using dts::func_scheduler;
+
+namespace {
+
+using clock_type = func_scheduler::clock_type;
+
+constexpr long timer_cnt = 20'000;
+
+long context_switches() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+// Spreads timer_cnt timers evenly over a second.
+void bench_slack(std::chrono::nanoseconds slack) {
+    dts::latency_histogram lateness;
+    std::mutex mtx;
+    dts::func_scheduler_options options;
+    options.slack = slack;
+    long switches_before;
+    {
+        func_scheduler fs(2, options);
+        const auto start = clock_type::now() + std::chrono::seconds(1);
+        const auto step = std::chrono::nanoseconds(std::chrono::seconds(1)) /
+                          timer_cnt;
+        for (long i = 0; i < timer_cnt; ++i) {
+            const auto when = start + step * i;
+            fs.run_at(when, [&lateness, &mtx, when] {
+                const auto late = clock_type::now() - when;
+                std::lock_guard<std::mutex> lkgrd(mtx);
+                lateness.record(late);
+            });
+        }
+        // Only count the switches while the timers fire.
+        std::this_thread::sleep_until(start - std::chrono::milliseconds(1));
+        switches_before = context_switches();
+        fs.wait();
+    }
+    std::printf("%10lld %18ld %14.1f %14.1f\n",
+                static_cast<long long>(
+                  std::chrono::duration_cast<std::chrono::microseconds>(slack)
+                    .count()),
+                context_switches() - switches_before,
+                lateness.percentile(50).count() / 1e3,
+                lateness.percentile(99).count() / 1e3);
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%ld timers over 1s on 2 workers\n", timer_cnt);
+    std::printf("%10s %18s %14s %14s\n", "slack(us)", "context switches",
+                "p50 late(us)", "p99 late(us)");
+    for (long slack : { 0, 100, 1000, 10000 }) {
+        bench_slack(std::chrono::microseconds(slack));
+    }
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "func_info_heap.hpp"
+#include "func_info_map.hpp"
+#include "timing_wheel.hpp"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// Lets the stores be drained without waiting for their functions to be due.
+struct manual_clock {
+    using duration = std::chrono::nanoseconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<manual_clock>;
+    static constexpr bool is_steady = true;
+
+    static inline time_point current{ std::chrono::hours(1) };
+
+    static time_point now() noexcept {
+        return current;
+    }
+};
+
+using tp_type = manual_clock::time_point;
+
+// Small enough not to dominate the stores themselves.
+struct noop {
+    void operator()() const noexcept {}
+};
+
+struct result {
+    double insert_ns;
+    double drain_ns;
+};
+
+// Connection idle timers: due at a random point of the next minute.
+std::vector<tp_type> make_times(std::size_t cnt) {
+    std::default_random_engine gen(cnt);
+    std::uniform_int_distribution<std::int64_t> dist(
+      1, std::chrono::nanoseconds(std::chrono::minutes(1)).count());
+    std::vector<tp_type> times;
+    times.reserve(cnt);
+    for (std::size_t i = 0; i < cnt; ++i) {
+        times.push_back(manual_clock::now() +
+                        std::chrono::nanoseconds(dist(gen)));
+    }
+    return times;
+}
+
+// Timers added in the order they're due, e.g. with a fixed timeout.
+std::vector<tp_type> make_sorted_times(std::size_t cnt) {
+    auto times = make_times(cnt);
+    std::sort(times.begin(), times.end());
+    return times;
+}
+
+template<typename Store, typename... Args>
+result bench(const std::vector<tp_type>& times, Args&&... args) {
+    const tp_type start_time = manual_clock::current;
+    result res{};
+    {
+        Store store(std::forward<Args>(args)...);
+        auto start = clock_type::now();
+        for (const tp_type& when : times) {
+            store.emplace(when, noop());
+        }
+        std::chrono::duration<double, std::nano> elapsed =
+          clock_type::now() - start;
+        res.insert_ns = elapsed.count() / times.size();
+
+        start = clock_type::now();
+        while (!store.empty()) {
+            const tp_type soonest = store.soonest_invoke_time();
+            if (soonest > manual_clock::now()) {
+                manual_clock::current = soonest;
+                continue;
+            }
+            store.extract_first_info().func()();
+        }
+        elapsed = clock_type::now() - start;
+        res.drain_ns = elapsed.count() / times.size();
+    }
+    manual_clock::current = start_time;
+    return res;
+}
+
+void print_row(std::size_t cnt, const result& map_res,
+               const result& heap_res, const result& wheel_res) {
+    std::printf("%10zu %12.1f %12.1f %12.1f %12.1f %12.1f %12.1f\n", cnt,
+                map_res.insert_ns, map_res.drain_ns, heap_res.insert_ns,
+                heap_res.drain_ns, wheel_res.insert_ns, wheel_res.drain_ns);
+}
+
+}  // namespace
+
+int main() {
+    using map_type = dts::func_info_map<tp_type, noop>;
+    using heap_type = dts::func_info_heap<tp_type, noop>;
+    using wheel_type = dts::timing_wheel<tp_type, noop>;
+
+    for (bool sorted : { false, true }) {
+        std::printf("cost per timer in ns, %s\n",
+                    sorted ? "inserted in order" : "random order");
+        std::printf("%10s %12s %12s %12s %12s %12s %12s\n", "pending",
+                    "map insert", "map drain", "heap insert", "heap drain",
+                    "wheel insert", "wheel drain");
+        for (std::size_t cnt : { 10'000, 1'000'000, 10'000'000 }) {
+            const auto times =
+              sorted ? make_sorted_times(cnt) : make_times(cnt);
+            print_row(cnt, bench<map_type>(times), bench<heap_type>(times),
+                      bench<wheel_type>(times, std::chrono::milliseconds(1)));
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include "func_scheduler.hpp"
+#include "latency_histogram.hpp"
+
+using dts::func_scheduler;
+
+namespace {
+
+using clock_type = func_scheduler::clock_type;
+
+constexpr long timer_cnt = 5'000;
+
+// Polls fs.fd() until stop is set, like an event loop.
+void event_loop(func_scheduler& fs, const std::atomic<bool>& stop) {
+    const int epfd = epoll_create1(0);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, fs.fd(), &ev);
+    while (!stop) {
+        if (epoll_wait(epfd, &ev, 1, 10) == 1) {
+            fs.process_expired();
+        }
+    }
+    close(epfd);
+}
+
+// Spreads timer_cnt timers evenly over a second and prints how late they ran.
+void bench_jitter(const char* name, dts::dispatch_mode mode,
+                  std::size_t worker_cnt) {
+    dts::latency_histogram lateness;
+    std::mutex mtx;
+    dts::func_scheduler_options options;
+    options.dispatch = mode;
+    {
+        func_scheduler fs(worker_cnt, options);
+        std::atomic<bool> stop(false);
+        std::thread loop;
+        if (mode == dts::dispatch_mode::timerfd) {
+            loop = std::thread([&fs, &stop] {
+                event_loop(fs, stop);
+            });
+        }
+        const auto start = clock_type::now() + std::chrono::milliseconds(100);
+        const auto step = std::chrono::nanoseconds(std::chrono::seconds(1)) /
+                          timer_cnt;
+        for (long i = 0; i < timer_cnt; ++i) {
+            const auto when = start + step * i;
+            fs.run_at(when, [&lateness, &mtx, when] {
+                const auto late = clock_type::now() - when;
+                std::lock_guard<std::mutex> lkgrd(mtx);
+                lateness.record(late);
+            });
+        }
+        fs.wait();
+        stop = true;
+        if (loop.joinable()) {
+            loop.join();
+        }
+    }
+    std::printf("%-20s %12.1f %12.1f %12.1f %12.1f\n", name,
+                lateness.percentile(50).count() / 1e3,
+                lateness.percentile(99).count() / 1e3,
+                lateness.percentile(99.9).count() / 1e3,
+                lateness.max().count() / 1e3);
+}
+
+}  // namespace
+
+int main() {
+    std::printf("%ld timers over 1s, lateness in us\n", timer_cnt);
+    std::printf("%-20s %12s %12s %12s %12s\n", "dispatch", "p50", "p99",
+                "p99.9", "max");
+    bench_jitter("cv, 1 worker", dts::dispatch_mode::thread, 1);
+    bench_jitter("cv, inline", dts::dispatch_mode::thread, 0);
+    bench_jitter("timerfd, 1 worker", dts::dispatch_mode::timerfd, 1);
+    bench_jitter("timerfd, inline", dts::dispatch_mode::timerfd, 0);
+
+    return 0;
+}
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "func_info_map.hpp"
+
+namespace dts {
+
+/**
+ * An array-backed Arity-ary min-heap with the interface of func_info_map.
+ *
+ * The heap itself only holds small entries, a time point, a sequence number
+ * and the index of the function's slot, in one contiguous vector. A wide heap
+ * is shallow, and the children of an entry share a cache line or two, so
+ * extracting the soonest function touches few cache lines and doesn't
+ * allocate or rebalance anything. The functions live in a vector of slots
+ * which are reused through a free list.
+ *
+ * It suits timers that are mostly extracted in order and rarely cancelled.
+ * Erasing a function frees its slot at once but leaves its entry in the heap
+ * until the entry reaches the top, and rescheduling pushes a new entry, so
+ * sifting never has to touch the slots. The heap is rebuilt without the stale
+ * entries once they outnumber the live ones.
+ *
+ * Like func_info_map, functions with the same time point are extracted in
+ * insertion order. Func must be default constructible and move assignable.
+ */
+template<typename TimePoint, typename Func, std::size_t Arity = 4>
+class func_info_heap {
+public:
+    static_assert(is_time_point<TimePoint>::value,
+                  "TimePoint must be of type std::chrono::time_point");
+    static_assert(std::is_invocable_r<void, Func>::value,
+                  "Func must be invocable without any argument and its return "
+                  "type must be void");
+    static_assert(Arity >= 2, "Arity must be at least 2");
+
+    using tp_type = TimePoint;
+    using func_type = Func;
+
+    static constexpr std::size_t arity = Arity;
+
+    // Identifies a function for erase() and reschedule().
+    struct handle_type {
+        std::uint32_t slot;
+        std::uint64_t seq;
+    };
+
+    class func_info {
+    public:
+        func_info(tp_type when, func_type&& func)
+            : when_(when),
+              func_(std::move(func)) {}
+
+        ~func_info() = default;
+
+        func_info(const func_info&) = delete;
+        func_info& operator=(const func_info&) = delete;
+        func_info(func_info&&) = default;
+
+        tp_type when() const noexcept {
+            return when_;
+        }
+
+        func_type& func() noexcept {
+            return func_;
+        }
+
+    private:
+        const tp_type when_;
+        func_type func_;
+    };
+
+    func_info_heap() = default;
+    ~func_info_heap() = default;
+
+    func_info_heap(const func_info_heap&) = delete;
+    func_info_heap& operator=(const func_info_heap&) = delete;
+
+    std::size_t size() const noexcept {
+        return size_;
+    }
+
+    template<typename Fn>
+    handle_type emplace(tp_type when, Fn&& fn) {
+        const std::uint32_t slot = allocate_slot();
+        slots_[slot].func = func_type(std::forward<Fn>(fn));
+        const handle_type handle{ slot, next_seq_++ };
+        push(when, handle);
+        ++size_;
+        return handle;
+    }
+
+    // nullptr if the function has already been extracted or erased.
+    func_type* find(const handle_type& handle) {
+        return valid(handle) ? &slots_[handle.slot].func : nullptr;
+    }
+
+    // Returns false if the function has already been extracted or erased.
+    bool erase(const handle_type& handle) {
+        if (!valid(handle)) {
+            return false;
+        }
+        release_slot(handle.slot);
+        --size_;
+        ++stale_;
+        drop_stale();
+        return true;
+    }
+
+    /**
+     * Moves a function to another time point. It goes after the functions
+     * already scheduled for that time point. Returns false if the function
+     * has already been extracted or erased.
+     */
+    bool reschedule(handle_type& handle, tp_type when) {
+        if (!valid(handle)) {
+            return false;
+        }
+        handle.seq = next_seq_++;
+        push(when, handle);
+        ++stale_;
+        drop_stale();
+        return true;
+    }
+
+    bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    tp_type soonest_invoke_time() const {
+        return heap_.front().when;
+    }
+
+    // The function extract_first_info() would return.
+    const func_type* peek_first() const {
+        return &slots_[heap_.front().slot].func;
+    }
+
+    func_info extract_first_info() {
+        const entry first = heap_.front();
+        pop();
+        func_type func = std::move(slots_[first.slot].func);
+        release_slot(first.slot);
+        --size_;
+        drop_stale();
+        return func_info(first.when, std::move(func));
+    }
+
+    // Schedules an extracted function again, in a slot from the free list.
+    handle_type reinsert(func_info&& info, tp_type when) {
+        return emplace(when, std::move(info.func()));
+    }
+
+private:
+    static constexpr std::uint32_t npos =
+      std::numeric_limits<std::uint32_t>::max();
+
+    struct entry {
+        tp_type when;
+        std::uint64_t seq;
+        std::uint32_t slot;
+    };
+
+    struct slot {
+        func_type func;
+        // The sequence number of the slot's live entry, 0 while it's free.
+        std::uint64_t seq = 0;
+        std::uint32_t next_free = npos;
+    };
+
+    // Rebuilding a small heap isn't worth it.
+    static constexpr std::size_t min_rebuild_size = 64;
+
+    std::vector<entry> heap_;
+    std::vector<slot> slots_;
+    std::uint32_t free_ = npos;
+    std::uint64_t next_seq_ = 1;
+    // Live functions.
+    std::size_t size_ = 0;
+    // Entries left behind by erase() and reschedule().
+    std::size_t stale_ = 0;
+
+    static bool before(const entry& a, const entry& b) noexcept {
+        return a.when < b.when || (a.when == b.when && a.seq < b.seq);
+    }
+
+    bool valid(const handle_type& handle) const noexcept {
+        return slots_[handle.slot].seq == handle.seq;
+    }
+
+    bool is_stale(const entry& e) const noexcept {
+        return slots_[e.slot].seq != e.seq;
+    }
+
+    void push(tp_type when, const handle_type& handle) {
+        slots_[handle.slot].seq = handle.seq;
+        heap_.push_back(entry{ when, handle.seq, handle.slot });
+        sift_up(heap_.size() - 1);
+    }
+
+    void pop() noexcept {
+        const entry last = heap_.back();
+        heap_.pop_back();
+        if (!heap_.empty()) {
+            sift_down(0, last);
+        }
+    }
+
+    void sift_up(std::size_t pos) noexcept {
+        const entry e = heap_[pos];
+        while (pos > 0) {
+            const std::size_t parent = (pos - 1) / arity;
+            if (!before(e, heap_[parent])) {
+                break;
+            }
+            heap_[pos] = heap_[parent];
+            pos = parent;
+        }
+        heap_[pos] = e;
+    }
+
+    void sift_down(std::size_t pos, const entry& e) noexcept {
+        const std::size_t size = heap_.size();
+        while (true) {
+            const std::size_t first_child = pos * arity + 1;
+            if (first_child >= size) {
+                break;
+            }
+            const std::size_t last_child =
+              first_child + arity < size ? first_child + arity : size;
+            std::size_t min_child = first_child;
+            for (std::size_t c = first_child + 1; c < last_child; ++c) {
+                if (before(heap_[c], heap_[min_child])) {
+                    min_child = c;
+                }
+            }
+            if (!before(heap_[min_child], e)) {
+                break;
+            }
+            heap_[pos] = heap_[min_child];
+            pos = min_child;
+        }
+        heap_[pos] = e;
+    }
+
+    // Keeps a live entry on top, and the stale ones from piling up.
+    void drop_stale() noexcept {
+        while (stale_ != 0 && !heap_.empty() && is_stale(heap_.front())) {
+            pop();
+            --stale_;
+        }
+        if (stale_ > size_ && stale_ >= min_rebuild_size) {
+            rebuild();
+        }
+    }
+
+    void rebuild() noexcept {
+        std::size_t live = 0;
+        for (const entry& e : heap_) {
+            if (!is_stale(e)) {
+                heap_[live++] = e;
+            }
+        }
+        heap_.resize(live);
+        stale_ = 0;
+        if (live < 2) {
+            return;
+        }
+        // Sifts down every entry that has children, the last one first.
+        for (std::size_t pos = (live - 2) / arity + 1; pos-- > 0;) {
+            const entry e = heap_[pos];
+            sift_down(pos, e);
+        }
+    }
+
+    std::uint32_t allocate_slot() {
+        if (free_ == npos) {
+            slots_.emplace_back();
+            return static_cast<std::uint32_t>(slots_.size() - 1);
+        }
+        const std::uint32_t index = free_;
+        free_ = slots_[index].next_free;
+        return index;
+    }
+
+    void release_slot(std::uint32_t index) noexcept {
+        slot& s = slots_[index];
+        s.func = func_type();
+        s.seq = 0;
+        s.next_free = free_;
+        free_ = index;
+    }
+};
+
+}  // namespace dts
@@ -1,8 +1,13 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <future>
 #include <map>
+#include <memory>
+#include <utility>
+
+#include "pool_allocator.hpp"
 
 namespace dts {
 
@@ -12,7 +17,12 @@ struct is_time_point : std::false_type {};
 template<typename Clock, typename Dur>
 struct is_time_point<std::chrono::time_point<Clock, Dur>> : std::true_type {};
 
-template<typename TimePoint, typename Func>
+/**
+ * Keeps functions in a std::map ordered by time point. Alloc is rebound to
+ * the map's value type, and its nodes come from it.
+ */
+template<typename TimePoint, typename Func,
+         typename Alloc = std::allocator<Func>>
 class func_info_map {
 public:
     static_assert(is_time_point<TimePoint>::value,
@@ -23,41 +33,86 @@ public:
 
     using tp_type = TimePoint;
     using func_type = Func;
-    using _container_type = std::multimap<tp_type, func_type>;
-
+    // Functions with the same time point are ordered by a sequence number.
+    using key_type = std::pair<tp_type, std::uint64_t>;
+    using allocator_type = typename std::allocator_traits<
+      Alloc>::template rebind_alloc<std::pair<const key_type, func_type>>;
+    using _container_type =
+      std::map<key_type, func_type, std::less<key_type>, allocator_type>;
+    // Identifies a function for erase() and reschedule().
+    using handle_type = key_type;
+
+    // Owns the node of an extracted function, which reinsert() reuses.
     class func_info {
     public:
         explicit func_info(typename _container_type::node_type&& node)
-            : when_(node.key()),
-              func_(std::move(node.mapped())) {}
+            : node_(std::move(node)) {}
 
         ~func_info() = default;
 
         func_info(const func_info&) = delete;
         func_info& operator=(const func_info&) = delete;
+        func_info(func_info&&) = default;
 
         tp_type when() const noexcept {
-            return when_;
+            return node_.key().first;
         }
 
         func_type& func() noexcept {
-            return func_;
+            return node_.mapped();
         }
 
     private:
-        const tp_type when_;
-        func_type func_;
+        friend class func_info_map;
+
+        typename _container_type::node_type node_;
     };
 
     func_info_map() = default;
+
+    explicit func_info_map(const Alloc& alloc)
+        : tfmap_(allocator_type(alloc)) {}
+
     ~func_info_map() = default;
 
     func_info_map(const func_info_map&) = delete;
     func_info_map& operator=(const func_info_map&) = delete;
 
-    template<typename... Args>
-    void emplace(Args&&... args) {
-        tfmap_.emplace(std::forward<Args>(args)...);
+    std::size_t size() const noexcept {
+        return tfmap_.size();
+    }
+
+    template<typename Fn>
+    handle_type emplace(tp_type when, Fn&& fn) {
+        const key_type key(when, next_seq_++);
+        tfmap_.emplace(key, std::forward<Fn>(fn));
+        return key;
+    }
+
+    // nullptr if the function has already been extracted or erased.
+    func_type* find(const handle_type& handle) {
+        auto it = tfmap_.find(handle);
+        return it != tfmap_.end() ? &it->second : nullptr;
+    }
+
+    // Returns false if the function has already been extracted or erased.
+    bool erase(const handle_type& handle) {
+        return tfmap_.erase(handle) != 0;
+    }
+
+    /**
+     * Moves a function to another time point, reusing its node. It goes after
+     * the functions already scheduled for that time point. Returns false if
+     * the function has already been extracted or erased.
+     */
+    bool reschedule(handle_type& handle, tp_type when) {
+        auto node = tfmap_.extract(handle);
+        if (node.empty()) {
+            return false;
+        }
+        node.key() = handle = key_type(when, next_seq_++);
+        tfmap_.insert(std::move(node));
+        return true;
     }
 
     bool empty() const noexcept {
@@ -65,16 +120,40 @@ public:
     }
 
     tp_type soonest_invoke_time() const {
-        return tfmap_.begin()->first;
+        return tfmap_.begin()->first.first;
+    }
+
+    // The function extract_first_info() would return.
+    const func_type* peek_first() const {
+        return &tfmap_.begin()->second;
     }
 
     func_info extract_first_info() {
         return func_info(tfmap_.extract(tfmap_.begin()));
     }
 
+    // Schedules an extracted function again without allocating.
+    handle_type reinsert(func_info&& info, tp_type when) {
+        auto& node = info.node_;
+        const key_type key(when, next_seq_++);
+        node.key() = key;
+        tfmap_.insert(std::move(node));
+        return key;
+    }
+
 private:
-    // time_point -> function. A time_point can map to multiple functions.
+    // (time_point, sequence number) -> function.
     _container_type tfmap_;
+    std::uint64_t next_seq_ = 0;
 };
 
+/**
+ * A func_info_map whose nodes come from a pool_allocator, so that scheduling
+ * and dispatching functions doesn't allocate nodes once the pool has warmed
+ * up. func_scheduler uses it.
+ */
+template<typename TimePoint, typename Func>
+using pooled_func_info_map =
+  func_info_map<TimePoint, Func, pool_allocator<Func>>;
+
 }  // namespace dts
@@ -1,71 +1,1204 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
 
+#include "executor.hpp"
+#include "func_info_heap.hpp"
 #include "func_info_map.hpp"
+#include "func_scheduler_options.hpp"
+#include "func_scheduler_stats.hpp"
+#include "task_queue.hpp"
+#include "thread_pool_overloaded.hpp"
+#include "thread_pool_stopped.hpp"
+#include "timer_fd.hpp"
+#include "timing_wheel.hpp"
+#include "unique_task.hpp"
 
 namespace dts {
 
-class func_scheduler {
+namespace detail {
+
+// A small number identifying the calling thread, handed out in turn.
+inline std::size_t thread_index() noexcept {
+    static std::atomic<std::size_t> next{ 0 };
+    thread_local const std::size_t index =
+      next.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+}  // namespace detail
+
+/**
+ * Runs functions at a given time.
+ *
+ * A dispatcher thread owns the timer bookkeeping. Whenever functions are due,
+ * it extracts all of them under one lock and hands them over in a batch,
+ * either to a task_queue polled by the scheduler's own workers, or to an
+ * executor such as a thread_pool. Workers don't take the scheduler's lock to
+ * run a function, so scheduling and running functions don't contend.
+ *
+ * A function may run up to its slack after its time point. The store orders
+ * functions by deadline, i.e. time point plus slack, and the dispatcher takes
+ * every function from the front of the store whose time point has passed
+ * once the soonest deadline is reached.
+ *
+ * Pending functions may be spread over several shards, each with a store and
+ * a lock of its own, see func_scheduler_options::shards. Every shard
+ * publishes its soonest deadline in an atomic, the dispatcher sleeps until
+ * the soonest of them, and a thread scheduling a function only wakes it up if
+ * the function is due before that.
+ *
+ * With dispatch_mode::timerfd there's no dispatcher thread. A timerfd is
+ * armed with the soonest deadline instead, and an event loop of the caller's
+ * calls process_expired() whenever fd() is readable.
+ *
+ * Store keeps the pending functions ordered by time. It's instantiated as
+ * Store<tp_type, func_type> and needs the interface of func_info_map:
+ * emplace(when, func) returning a handle_type, find(handle), erase(handle),
+ * reschedule(handle, when), empty(), soonest_invoke_time(), peek_first(),
+ * extract_first_info() returning a movable func_info, and
+ * reinsert(info, when). A Store constructible from a tick length, such as
+ * timing_wheel, gets func_scheduler_options::tick.
+ */
+template<template<typename, typename> class Store>
+class basic_func_scheduler {
 public:
     using clock_type = std::chrono::steady_clock;
     using tp_type =
       std::chrono::time_point<clock_type, std::chrono::nanoseconds>;
-    using func_type = std::packaged_task<void()>;
 
-    func_scheduler(std::size_t worker_cnt);
-    ~func_scheduler();
+private:
+    struct periodic_state;
+
+public:
+    // What the store holds for every scheduled function.
+    struct job {
+        unique_task task;
+        // Set for functions scheduled by run_every(), which are put back into
+        // the store after each run.
+        std::shared_ptr<periodic_state> periodic;
+        // The store has the function under earliest + slack.
+        tp_type earliest;
+        std::chrono::nanoseconds slack;
+        // Set for functions that run once, and called on task when it's
+        // dispatched, with the earliest it's due at by then.
+        void (*arm)(unique_task& task, basic_func_scheduler* owner,
+                    const tp_type& when);
+
+        void operator()() {
+            task();
+        }
+    };
+
+    using func_type = job;
+    using store_type = Store<tp_type, func_type>;
+
+private:
+    struct shard;
+
+    // Where a scheduled function is kept.
+    struct job_id {
+        shard* home = nullptr;
+        typename store_type::handle_type id{};
+    };
+
+    struct periodic_state {
+        periodic_state(std::chrono::nanoseconds p, const periodic_options& o)
+            : period(p),
+              options(o) {}
+
+        const std::chrono::nanoseconds period;
+        const periodic_options options;
+        // Guarded by mtx_.
+        bool cancelled = false;
+        // Guarded by the mutex of id.home, which never changes.
+        job_id id;
+        // Holds the entry from its dispatch until it's reinserted.
+        std::optional<typename store_type::func_info> info;
+    };
+
+    /**
+     * Calls finish_one() on its owner when destroyed, unless moved from.
+     * Dispatched functions hold one, so that they're done once they have run
+     * or have been destroyed without running, e.g. dropped by the executor.
+     */
+    class finish_guard {
+    public:
+        explicit finish_guard(basic_func_scheduler* owner = nullptr) noexcept
+            : owner_(owner) {}
+
+        finish_guard(finish_guard&& other) noexcept
+            : owner_(std::exchange(other.owner_, nullptr)) {}
+
+        finish_guard& operator=(finish_guard&&) = delete;
+
+        ~finish_guard() {
+            if (owner_ != nullptr) {
+                owner_->finish_one();
+            }
+        }
+
+        void arm(basic_func_scheduler* owner) noexcept {
+            owner_ = owner;
+        }
+
+        basic_func_scheduler* owner() const noexcept {
+            return owner_;
+        }
+
+    private:
+        basic_func_scheduler* owner_;
+    };
+
+    // What a function scheduled to run once runs as. Destroyed without
+    // running once dispatched, it breaks its promise.
+    template<typename R>
+    class one_shot_run {
+    public:
+        explicit one_shot_run(std::packaged_task<R()>&& ptask) noexcept
+            : ptask_(std::move(ptask)) {}
+
+        one_shot_run(one_shot_run&&) noexcept = default;
+        one_shot_run& operator=(one_shot_run&&) = delete;
+
+        // The job's arm.
+        static void arm(unique_task& task, basic_func_scheduler* owner,
+                        const tp_type& when) noexcept {
+            one_shot_run& run = *task.target<one_shot_run>();
+            run.done_.arm(owner);
+#if DTS_FUNC_SCHEDULER_STATS
+            run.when_ = when;
+#else
+            static_cast<void>(when);
+#endif
+        }
+
+        void operator()() {
+            const finish_guard done(std::move(done_));
+#if DTS_FUNC_SCHEDULER_STATS
+            const tp_type start = done.owner()->record_start(when_);
+#endif
+            ptask_();
+#if DTS_FUNC_SCHEDULER_STATS
+            done.owner()->record_finish(start);
+#endif
+        }
+
+    private:
+        // Destroyed last, once the promise is broken.
+        finish_guard done_;
+        std::packaged_task<R()> ptask_;
+#if DTS_FUNC_SCHEDULER_STATS
+        tp_type when_;
+#endif
+    };
+
+    // What a dispatched periodic function runs as. If it's destroyed without
+    // running, e.g. refused by the executor, the function is dropped.
+    class periodic_run {
+    public:
+        periodic_run(basic_func_scheduler* owner,
+                     periodic_state* state) noexcept
+            : done_(owner),
+              state_(state) {}
+
+        periodic_run(periodic_run&&) noexcept = default;
+        periodic_run& operator=(periodic_run&&) = delete;
+
+        ~periodic_run() {
+            if (done_.owner() != nullptr) {
+                done_.owner()->drop_periodic(*state_);
+            }
+        }
+
+        void operator()() {
+            const finish_guard done(std::move(done_));
+            done.owner()->run_periodic(*state_);
+        }
+
+    private:
+        finish_guard done_;
+        periodic_state* state_;
+    };
+
+public:
+    /**
+     * Returned by run_at() and run_after(). Holds the future of the function
+     * and lets it be cancelled or moved to another time until it's
+     * dispatched. Must not outlive the scheduler. A default-constructed
+     * handle holds no function, and cancelling or moving it returns false.
+     */
+    template<typename R>
+    class handle {
+    public:
+        handle() = default;
+
+        std::future<R>& future() noexcept {
+            return future_;
+        }
+
+        R get() {
+            return future_.get();
+        }
+
+        void wait() const {
+            future_.wait();
+        }
+
+        /**
+         * Removes the function from the scheduler, and its future gets a
+         * broken_promise error. Returns false if cancelling lost the race:
+         * the function has been dispatched, or was already cancelled.
+         */
+        bool cancel() {
+            return owner_ != nullptr && owner_->cancel(id_);
+        }
+
+        /**
+         * Runs the function at when instead, keeping its slack. Returns false
+         * if the function has been dispatched, or cancelled.
+         */
+        template<typename Dur>
+        bool reschedule(const std::chrono::time_point<clock_type, Dur>& when) {
+            check_not_passed(when);
+            return owner_ != nullptr && owner_->reschedule(id_, when);
+        }
+
+        template<typename Dur>
+        bool reschedule_after(const Dur& dur) {
+            check_positive(dur);
+            return owner_ != nullptr &&
+                   owner_->reschedule(id_, clock_type::now() + dur);
+        }
+
+    private:
+        friend class basic_func_scheduler;
+
+        handle(basic_func_scheduler* owner, const job_id& id,
+               std::future<R>&& future)
+            : owner_(owner),
+              id_(id),
+              future_(std::move(future)) {}
+
+        basic_func_scheduler* owner_ = nullptr;
+        job_id id_;
+        std::future<R> future_;
+    };
+
+    /**
+     * Returned by run_every(). Must not outlive the scheduler. Cancelling a
+     * default-constructed one returns false.
+     */
+    class periodic_handle {
+    public:
+        periodic_handle() = default;
+
+        /**
+         * Stops the repetition: a run in progress finishes, but no other one
+         * starts. Returns false if it had already been cancelled, either
+         * through this handle or by wait().
+         */
+        bool cancel() {
+            return owner_ != nullptr && owner_->cancel_periodic(state_);
+        }
+
+    private:
+        friend class basic_func_scheduler;
 
-    func_scheduler(const func_scheduler&) = delete;
-    func_scheduler& operator=(const func_scheduler&) = delete;
+        periodic_handle(basic_func_scheduler* owner,
+                        std::shared_ptr<periodic_state> state)
+            : owner_(owner),
+              state_(std::move(state)) {}
+
+        basic_func_scheduler* owner_ = nullptr;
+        std::shared_ptr<periodic_state> state_;
+    };
+
+    /**
+     * Runs functions on worker_cnt threads of its own. With no workers, they
+     * run on the thread dispatching them, which is meant for
+     * dispatch_mode::timerfd, where that's the caller's event loop.
+     */
+    explicit basic_func_scheduler(
+      std::size_t worker_cnt,
+      const func_scheduler_options& options = func_scheduler_options());
+
+    /**
+     * Runs functions on exec, e.g. a thread_pool, which must outlive the
+     * scheduler. Functions that exec refuses with thread_pool_stopped or
+     * thread_pool_overloaded, or destroys without running them, e.g. on
+     * thread_pool::shutdown_now(), are dropped: their futures get a
+     * broken_promise error, and periodic functions are cancelled.
+     */
+    explicit basic_func_scheduler(
+      executor& exec,
+      const func_scheduler_options& options = func_scheduler_options());
+
+    /**
+     * Waits for the functions scheduled so far, like wait(). With
+     * dispatch_mode::timerfd, destroying it on the event loop calling
+     * process_expired() while functions are pending therefore never returns.
+     * Cancel them first, or destroy it on another thread.
+     */
+    ~basic_func_scheduler();
+
+    basic_func_scheduler(const basic_func_scheduler&) = delete;
+    basic_func_scheduler& operator=(const basic_func_scheduler&) = delete;
 
     template<typename Dur, typename Fn, typename... Args>
     decltype(auto) run_after(const Dur& dur, Fn&& fn, Args&&... args) {
-        static_assert(std::chrono::__is_duration<Dur>::value,
-                      "dur must be of type std::chrono::duration.");
-        const tp_type now = clock_type::now();
-        return run_at(now + dur, std::forward<Fn>(fn),
-                      std::forward<Args>(args)...);
+        return run_after_within(dur, slack_, std::forward<Fn>(fn),
+                                std::forward<Args>(args)...);
     }
 
     template<typename Dur, typename Fn, typename... Args>
     decltype(auto) run_at(const std::chrono::time_point<clock_type, Dur>& when,
                           Fn&& fn, Args&&... args) {
+        return run_at_within(when, slack_, std::forward<Fn>(fn),
+                             std::forward<Args>(args)...);
+    }
+
+    // Like run_after(), but the function may run up to slack late.
+    template<typename Dur, typename SlackDur, typename Fn, typename... Args>
+    decltype(auto) run_after_within(const Dur& dur, const SlackDur& slack,
+                                    Fn&& fn, Args&&... args) {
+        static_assert(std::chrono::__is_duration<Dur>::value,
+                      "dur must be of type std::chrono::duration.");
+        // Not compared to the clock again, which a preempted caller may find
+        // past now + dur.
+        check_positive(dur);
         const tp_type now = clock_type::now();
-        if (when <= now) {
-            throw std::invalid_argument(
-              "Can't postpone a function that should've been run before now");
+        return schedule(now + dur, slack, std::forward<Fn>(fn),
+                        std::forward<Args>(args)...);
+    }
+
+    // Like run_at(), but the function may run up to slack late.
+    template<typename Dur, typename SlackDur, typename Fn, typename... Args>
+    decltype(auto) run_at_within(
+      const std::chrono::time_point<clock_type, Dur>& when,
+      const SlackDur& slack, Fn&& fn, Args&&... args) {
+        check_not_passed(when);
+        return schedule(when, slack, std::forward<Fn>(fn),
+                        std::forward<Args>(args)...);
+    }
+
+    /**
+     * Schedules the callable of every (time point, callable) pair in
+     * [first, last), e.g. a range of std::pair, and returns their handles in
+     * order. All of them are inserted into the calling thread's shard under
+     * one lock acquisition, and the dispatcher is woken up at most once, only
+     * if it sleeps past the soonest of them. Callables are copied, or moved
+     * through a std::move_iterator. Throws std::invalid_argument before
+     * scheduling anything if a time point has passed.
+     */
+    template<typename InputIt>
+    auto run_at_bulk(InputIt first, InputIt last) {
+        return schedule_bulk(first, last, [](const auto& when) {
+            check_not_passed(when);
+            return tp_type(when);
+        });
+    }
+
+    // Like run_at_bulk(), for (duration, callable) pairs counted from now.
+    template<typename InputIt>
+    auto run_after_bulk(InputIt first, InputIt last) {
+        const tp_type now = clock_type::now();
+        return schedule_bulk(first, last, [now](const auto& dur) {
+            check_positive(dur);
+            return now + dur;
+        });
+    }
+
+    /**
+     * Runs fn every period, starting a period from now, until the returned
+     * handle cancels it or wait() is called. The function is stored once and
+     * its entry is reused, so a run costs no allocation. fn must not throw.
+     */
+    template<typename Dur, typename Fn>
+    periodic_handle run_every(
+      const Dur& period, Fn&& fn,
+      const periodic_options& options = periodic_options()) {
+        static_assert(std::chrono::__is_duration<Dur>::value,
+                      "period must be of type std::chrono::duration.");
+        if (period <= Dur::zero()) {
+            throw std::invalid_argument("period must be positive");
         }
-        using fn_res_t = std::invoke_result_t<Fn, Args...>;
-        std::packaged_task<fn_res_t()> ptask(
-          std::bind(std::forward<Fn>(fn), std::forward<Args>(args)...));
-        auto future = ptask.get_future();
+        const std::chrono::nanoseconds slack = options.slack.value_or(slack_);
+        check_slack(slack);
+        auto state = std::make_shared<periodic_state>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(period),
+          options);
+        job j{ unique_task(std::forward<Fn>(fn)), state,
+               clock_type::now() + period, slack, nullptr };
+        const tp_type deadline = j.earliest + j.slack;
+        shard& s = local_shard();
         {
             std::lock_guard<std::mutex> lkgrd(mtx_);
-            todo_.emplace(when, std::move(ptask));
+            if (!accept_new_) {
+                throw std::logic_error(
+                  "Can't start a periodic function after wait()");
+            }
+            std::lock_guard<std::mutex> shard_lkgrd(s.mtx);
+            state->id = job_id{ &s, s.todo.emplace(deadline, std::move(j)) };
+            publish(s);
+            periodic_.push_back(state);
         }
-        dispatch_cv_.notify_one();
-        return future;
+        wake_dispatcher(deadline);
+        return periodic_handle(this, std::move(state));
     }
 
+    /**
+     * Waits until every function scheduled so far has run, including those
+     * that running functions schedule meanwhile. Periodic functions are
+     * cancelled first. With dispatch_mode::timerfd, another thread has to
+     * keep calling process_expired() meanwhile: called from the event loop
+     * itself while functions are pending, it never returns.
+     */
     void wait();
 
+    /**
+     * The timerfd with dispatch_mode::timerfd, to be polled for reading, e.g.
+     * with EPOLLIN. It's readable once a function is due. -1 with
+     * dispatch_mode::thread.
+     */
+    int fd() const noexcept {
+        return timer_ ? timer_->fd() : -1;
+    }
+
+    /**
+     * With dispatch_mode::timerfd, dispatches every due function and arms
+     * fd() with the next deadline. Called whenever fd() is readable, by one
+     * thread at a time. Returns the number of functions dispatched. Throws
+     * std::logic_error with dispatch_mode::thread.
+     */
+    std::size_t process_expired();
+
+    /**
+     * How late functions have started, how long they ran, and how many were
+     * pending when due ones were dispatched. Without DTS_FUNC_SCHEDULER_STATS
+     * only pending_funcs and in_flight_funcs are filled.
+     */
+    func_scheduler_stats stats() const;
+
 private:
+    using rep_type = tp_type::rep;
+
+    static constexpr rep_type never = tp_type::max().time_since_epoch().count();
+    static constexpr rep_type awake = tp_type::min().time_since_epoch().count();
+
+    // Some of the pending functions, with a lock of their own.
+    struct alignas(64) shard {
+        explicit shard(const func_scheduler_options& options)
+            : todo(make_store(options)) {}
+
+        std::mutex mtx;
+        store_type todo;
+        // Published under mtx for the dispatcher, which reads them without
+        // it: the soonest deadline in todo, and the time point of the
+        // function extract_first_info() returns, if the store knows it. Both
+        // are max() when there's no such function. And the size of todo.
+        std::atomic<rep_type> soonest{ never };
+        std::atomic<rep_type> first_earliest{ never };
+        std::atomic<std::size_t> size{ 0 };
+    };
+
+#if DTS_FUNC_SCHEDULER_STATS
+    // What functions record when they run. Threads pick one by
+    // detail::thread_index(), so workers rarely share one.
+    struct alignas(64) run_counters {
+        detail::shared_histogram lateness;
+        detail::shared_histogram run_time;
+        std::atomic<std::int64_t> busy_ns{ 0 };
+    };
+#endif
+
+    // Guards accept_new_, stopping_ and periodic_, and the dispatcher sleeps
+    // on it. With a timer_, guards arming it.
     std::mutex mtx_;
     std::condition_variable all_done_cv_;
     std::condition_variable dispatch_cv_;
-    std::condition_variable worker_cv_;
 
+    const std::chrono::nanoseconds slack_;
     bool accept_new_ = true;
-    std::thread dispatcher_{ [this] {
-        dispatch_func();
-    } };
+    // Set by the destructor to stop the dispatcher.
+    bool stopping_ = false;
+    std::vector<std::unique_ptr<shard>> shards_;
+    // When the dispatcher sleeps until, or timer_ is armed with: never while
+    // nothing is pending, and awake while functions are being dispatched.
+    std::atomic<rep_type> wake_at_{ awake };
+    // Periodic functions that haven't been cancelled.
+    std::vector<std::shared_ptr<periodic_state>> periodic_;
+    // Functions dispatched but not done yet. Incremented under the lock of
+    // the shard they were taken from, before it's published.
+    std::atomic<std::size_t> in_flight_{ 0 };
+    // Set when the scheduler runs functions on workers_, otherwise exec_ is.
+    std::unique_ptr<task_queue> ready_;
+    executor* const exec_;
+    // Set with dispatch_mode::timerfd, in place of dispatcher_.
+    const std::unique_ptr<timer_fd> timer_;
+    // The batch process_expired() reuses.
+    std::vector<unique_task> expired_;
+#if DTS_FUNC_SCHEDULER_STATS
+    std::vector<std::unique_ptr<run_counters>> run_counters_ =
+      make_run_counters();
+    // Only recorded by the thread dispatching functions.
+    detail::recording_count_histogram queue_depth_;
+#endif
+    std::thread dispatcher_;
     std::vector<std::thread> workers_;
-    func_info_map<tp_type, func_type> todo_;
 
+    static void check_not_passed(const tp_type& when) {
+        if (when <= clock_type::now()) {
+            throw std::invalid_argument(
+              "Can't postpone a function that should've been run before now");
+        }
+    }
+
+    template<typename Dur>
+    static void check_positive(const Dur& dur) {
+        if (dur <= Dur::zero()) {
+            throw std::invalid_argument(
+              "Can't postpone a function that should've been run before now");
+        }
+    }
+
+    template<typename SlackDur>
+    static void check_slack(const SlackDur& slack) {
+        if (slack < SlackDur::zero()) {
+            throw std::invalid_argument("slack must not be negative");
+        }
+    }
+
+    bool cancel(const job_id& id);
+    bool reschedule(job_id& id, const tp_type& when);
+    bool cancel_periodic(const std::shared_ptr<periodic_state>& state);
+    // Must be called with mtx_ held.
+    void stop_periodic(periodic_state& state);
+    void run_periodic(periodic_state& state);
+    void drop_periodic(periodic_state& state);
+    // Called once a dispatched function is done.
+    void finish_one();
+
+    // Implements run_at_within() and run_after_within() once when is known to
+    // be ahead.
+    template<typename SlackDur, typename Fn, typename... Args>
+    auto schedule(const tp_type& when, const SlackDur& slack, Fn&& fn,
+                  Args&&... args) {
+        static_assert(std::chrono::__is_duration<SlackDur>::value,
+                      "slack must be of type std::chrono::duration.");
+        check_slack(slack);
+        using fn_res_t = std::invoke_result_t<Fn, Args...>;
+        std::packaged_task<fn_res_t()> ptask(
+          std::bind(std::forward<Fn>(fn), std::forward<Args>(args)...));
+        auto future = ptask.get_future();
+        job j = make_job(std::move(ptask), when, slack);
+        const tp_type deadline = j.earliest + j.slack;
+        shard& s = local_shard();
+        job_id id{ &s };
+        {
+            std::lock_guard<std::mutex> lkgrd(s.mtx);
+            id.id = s.todo.emplace(deadline, std::move(j));
+            publish(s);
+        }
+        wake_dispatcher(deadline);
+        return handle<fn_res_t>(this, id, std::move(future));
+    }
+
+    template<typename R>
+    job make_job(std::packaged_task<R()>&& ptask, const tp_type& when,
+                 std::chrono::nanoseconds slack) {
+        using run_type = one_shot_run<R>;
+        static_assert(unique_task::is_stored_inline<run_type>,
+                      "one_shot_run must be stored inline by unique_task");
+        return job{ unique_task(run_type(std::move(ptask))), nullptr, when,
+                    slack, &run_type::arm };
+    }
+
+#if DTS_FUNC_SCHEDULER_STATS
+    static std::vector<std::unique_ptr<run_counters>> make_run_counters() {
+        std::vector<std::unique_ptr<run_counters>> counters;
+        const std::size_t cnt =
+          std::clamp<std::size_t>(std::thread::hardware_concurrency(), 1, 16);
+        for (std::size_t i = 0; i < cnt; ++i) {
+            counters.push_back(std::make_unique<run_counters>());
+        }
+        return counters;
+    }
+
+    run_counters& local_run_counters() noexcept {
+        return *run_counters_[detail::thread_index() % run_counters_.size()];
+    }
+
+    // Called right before a function due at when runs. Returns the time it
+    // started.
+    tp_type record_start(const tp_type& when) noexcept {
+        const tp_type now = clock_type::now();
+        local_run_counters().lateness.record(now - when);
+        return now;
+    }
+
+    void record_finish(const tp_type& start) noexcept {
+        const std::chrono::nanoseconds run_time = clock_type::now() - start;
+        run_counters& counters = local_run_counters();
+        counters.run_time.record(run_time);
+        counters.busy_ns.fetch_add(run_time.count(),
+                                   std::memory_order_relaxed);
+    }
+#endif
+
+    // Implements run_at_bulk() and run_after_bulk(). to_tp checks the first
+    // element of a pair and turns it into a time point.
+    template<typename InputIt, typename ToTp>
+    auto schedule_bulk(InputIt first, InputIt last, ToTp&& to_tp) {
+        using item_type = typename std::iterator_traits<InputIt>::value_type;
+        using fn_type = std::decay_t<std::tuple_element_t<1, item_type>>;
+        using fn_res_t = std::invoke_result_t<fn_type&>;
+        std::vector<job> jobs;
+        std::vector<handle<fn_res_t>> handles;
+        using category =
+          typename std::iterator_traits<InputIt>::iterator_category;
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, category>) {
+            jobs.reserve(std::distance(first, last));
+            handles.reserve(jobs.capacity());
+        }
+        for (; first != last; ++first) {
+            auto&& item = *first;
+            const tp_type when = to_tp(std::get<0>(item));
+            std::packaged_task<fn_res_t()> ptask(
+              std::get<1>(std::forward<decltype(item)>(item)));
+            handles.push_back(handle<fn_res_t>(this, {}, ptask.get_future()));
+            jobs.push_back(make_job(std::move(ptask), when, slack_));
+        }
+        if (jobs.empty()) {
+            return handles;
+        }
+        shard& s = local_shard();
+        tp_type soonest = tp_type::max();
+        {
+            std::lock_guard<std::mutex> lkgrd(s.mtx);
+            for (std::size_t i = 0; i < jobs.size(); ++i) {
+                const tp_type deadline = jobs[i].earliest + jobs[i].slack;
+                soonest = std::min(soonest, deadline);
+                handles[i].id_ =
+                  job_id{ &s, s.todo.emplace(deadline, std::move(jobs[i])) };
+            }
+            publish(s);
+        }
+        wake_dispatcher(soonest);
+        return handles;
+    }
+
+    static store_type make_store(const func_scheduler_options& options) {
+        if constexpr (std::is_constructible_v<store_type,
+                                              std::chrono::nanoseconds>) {
+            return store_type(options.tick);
+        }
+        else {
+            return store_type();
+        }
+    }
+
+    static std::vector<std::unique_ptr<shard>> make_shards(
+      const func_scheduler_options& options) {
+        std::vector<std::unique_ptr<shard>> shards;
+        const std::size_t cnt = std::max<std::size_t>(options.shards, 1);
+        for (std::size_t i = 0; i < cnt; ++i) {
+            shards.push_back(std::make_unique<shard>(options));
+        }
+        return shards;
+    }
+
+    shard& local_shard() noexcept {
+        return *shards_[detail::thread_index() % shards_.size()];
+    }
+
+    // Must be called with s.mtx held, after every change to s.todo.
+    static void publish(shard& s) {
+        rep_type soonest = never;
+        rep_type first_earliest = never;
+        if (!s.todo.empty()) {
+            soonest = s.todo.soonest_invoke_time().time_since_epoch().count();
+            if (const job* first = s.todo.peek_first()) {
+                first_earliest = first->earliest.time_since_epoch().count();
+            }
+        }
+        s.soonest.store(soonest);
+        s.first_earliest.store(first_earliest);
+        s.size.store(s.todo.size(), std::memory_order_relaxed);
+    }
+
+    // The soonest deadline over all shards.
+    tp_type soonest_deadline() const noexcept {
+        rep_type soonest = never;
+        for (const auto& s : shards_) {
+            soonest = std::min(soonest, s->soonest.load());
+        }
+        return tp_type(tp_type::duration(soonest));
+    }
+
+    bool all_empty() const noexcept {
+        return soonest_deadline() == tp_type::max();
+    }
+
+    static std::unique_ptr<timer_fd> make_timer(
+      const func_scheduler_options& options) {
+        if (options.dispatch == dispatch_mode::timerfd) {
+            return std::make_unique<timer_fd>();
+        }
+        return nullptr;
+    }
+
+    /**
+     * Called once deadline has been published. Wakes the dispatcher up, or
+     * arms timer_ sooner, if it would go off past deadline. Either this sees
+     * the time it goes off at, or the dispatcher sees deadline before going
+     * to sleep.
+     */
+    void wake_dispatcher(const tp_type& deadline) {
+        const rep_type deadline_rep = deadline.time_since_epoch().count();
+        if (deadline_rep < wake_at_.load()) {
+            std::lock_guard<std::mutex> lkgrd(mtx_);
+            if (!timer_) {
+                dispatch_cv_.notify_one();
+            }
+            else if (deadline_rep < wake_at_.load()) {
+                timer_->arm(deadline.time_since_epoch());
+                wake_at_.store(deadline_rep);
+            }
+        }
+    }
+
+    void start_dispatcher();
+
+    // Moves every due function to batch, locking one shard at a time.
+    void take_due(std::vector<unique_task>& batch);
+    // Runs or hands over the functions in batch, and clears it.
+    void hand_off(std::vector<unique_task>& batch);
     void dispatch_func();
     void work_func();
 };
 
+template<template<typename, typename> class Store>
+basic_func_scheduler<Store>::basic_func_scheduler(
+  std::size_t worker_cnt, const func_scheduler_options& options)
+    : slack_(options.slack),
+      shards_(make_shards(options)),
+      ready_(std::make_unique<task_queue>()),
+      exec_(nullptr),
+      timer_(make_timer(options)) {
+    // Before the dispatcher, which checks whether there are any.
+    while (worker_cnt--) {
+        workers_.emplace_back([this] {
+            work_func();
+        });
+    }
+    start_dispatcher();
+}
+
+template<template<typename, typename> class Store>
+basic_func_scheduler<Store>::basic_func_scheduler(
+  executor& exec, const func_scheduler_options& options)
+    : slack_(options.slack),
+      shards_(make_shards(options)),
+      exec_(&exec),
+      timer_(make_timer(options)) {
+    start_dispatcher();
+}
+
+template<template<typename, typename> class Store>
+basic_func_scheduler<Store>::~basic_func_scheduler() {
+    wait();
+    if (dispatcher_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lkgrd(mtx_);
+            stopping_ = true;
+        }
+        dispatch_cv_.notify_one();
+        dispatcher_.join();
+    }
+    if (ready_) {
+        ready_->stop_push();
+    }
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+template<template<typename, typename> class Store>
+void basic_func_scheduler<Store>::start_dispatcher() {
+    if (timer_) {
+        // Disarmed until a function is scheduled.
+        wake_at_.store(never);
+        return;
+    }
+    dispatcher_ = std::thread([this] {
+        dispatch_func();
+    });
+}
+
+template<template<typename, typename> class Store>
+void basic_func_scheduler<Store>::wait() {
+    std::unique_lock<std::mutex> ulock(mtx_);
+    accept_new_ = false;
+    while (!periodic_.empty()) {
+        stop_periodic(*periodic_.back());
+    }
+    // Even if wait() has already been called, running functions may have
+    // scheduled more since. take_due() counts functions in flight before a
+    // shard looks empty, and the last one only finishes under mtx_, so none
+    // slips between reading the shards and in_flight_.
+    all_done_cv_.wait(ulock, [this] {
+        return all_empty() && in_flight_.load() == 0;
+    });
+}
+
+template<template<typename, typename> class Store>
+bool basic_func_scheduler<Store>::cancel(const job_id& id) {
+    shard& s = *id.home;
+    {
+        std::lock_guard<std::mutex> lkgrd(s.mtx);
+        if (!s.todo.erase(id.id)) {
+            return false;
+        }
+        publish(s);
+    }
+    // It may have been the last function wait() was waiting for, which
+    // checks the shards under mtx_.
+    std::lock_guard<std::mutex> lkgrd(mtx_);
+    all_done_cv_.notify_one();
+    return true;
+}
+
+template<template<typename, typename> class Store>
+bool basic_func_scheduler<Store>::reschedule(job_id& id,
+                                             const tp_type& when) {
+    shard& s = *id.home;
+    tp_type deadline;
+    {
+        std::lock_guard<std::mutex> lkgrd(s.mtx);
+        job* j = s.todo.find(id.id);
+        if (j == nullptr) {
+            return false;
+        }
+        j->earliest = when;
+        deadline = when + j->slack;
+        s.todo.reschedule(id.id, deadline);
+        publish(s);
+    }
+    wake_dispatcher(deadline);
+    return true;
+}
+
+template<template<typename, typename> class Store>
+bool basic_func_scheduler<Store>::cancel_periodic(
+  const std::shared_ptr<periodic_state>& state) {
+    std::lock_guard<std::mutex> lkgrd(mtx_);
+    if (state->cancelled) {
+        return false;
+    }
+    stop_periodic(*state);
+    all_done_cv_.notify_one();
+    return true;
+}
+
+template<template<typename, typename> class Store>
+void basic_func_scheduler<Store>::stop_periodic(periodic_state& state) {
+    state.cancelled = true;
+    // Fails while the function is dispatched, and run_periodic() won't put it
+    // back then.
+    shard& s = *state.id.home;
+    {
+        std::lock_guard<std::mutex> lkgrd(s.mtx);
+        if (s.todo.erase(state.id.id)) {
+            publish(s);
+        }
+    }
+    auto it = std::find_if(periodic_.begin(), periodic_.end(),
+                           [&state](const auto& p) {
+                               return p.get() == &state;
+                           });
+    periodic_.erase(it);
+}
+
+template<template<typename, typename> class Store>
+void basic_func_scheduler<Store>::run_periodic(periodic_state& state) {
+    job& j = state.info->func();
+#if DTS_FUNC_SCHEDULER_STATS
+    // earliest is still the time point this run was due at.
+    const tp_type start = record_start(j.earliest);
+#endif
+    std::invoke(j);
+#if DTS_FUNC_SCHEDULER_STATS
+    record_finish(start);
+#endif
+    const tp_type now = clock_type::now();
+    tp_type& next = j.earliest;
+    if (state.options.mode == periodic_mode::fixed_delay) {
+        next = now + state.period;
+    }
+    else {
+        next += state.period;
+        if (next <= now && state.options.overrun == overrun_policy::skip) {
+            next += (now - next) / state.period * state.period + state.period;
+        }
+    }
+    const tp_type deadline = next + j.slack;
+    // Once cancelled, the entry may hold the last reference to state, so it's
+    // released after everything else.
+    std::optional<typename store_type::func_info> dropped;
+    {
+        std::lock_guard<std::mutex> lkgrd(mtx_);
+        if (state.cancelled) {
+            dropped.emplace(std::move(*state.info));
+        }
+        else {
+            shard& s = *state.id.home;
+            std::lock_guard<std::mutex> shard_lkgrd(s.mtx);
+            state.id.id = s.todo.reinsert(std::move(*state.info), deadline);
+            publish(s);
+        }
+        state.info.reset();
+    }
+    if (!dropped) {
+        wake_dispatcher(deadline);
+    }
+}
+
+template<template<typename, typename> class Store>
+void basic_func_scheduler<Store>::drop_periodic(periodic_state& state) {
+    // The entry holds a reference to state, so it's released last.
+    std::optional<typename store_type::func_info> dropped;
+    std::lock_guard<std::mutex> lkgrd(mtx_);
+    dropped.emplace(std::move(*state.info));
+    state.info.reset();
+    if (!state.cancelled) {
+        stop_periodic(state);
+    }
+}
+
+template<template<typename, typename> class Store>
+void basic_func_scheduler<Store>::finish_one() {
+    std::size_t cnt = in_flight_.load(std::memory_order_relaxed);
+    while (cnt > 1) {
+        if (in_flight_.compare_exchange_weak(cnt, cnt - 1,
+                                             std::memory_order_acq_rel)) {
+            return;
+        }
+    }
+    // Possibly the last one, which wait() must not miss.
+    std::lock_guard<std::mutex> lkgrd(mtx_);
+    if (in_flight_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        all_done_cv_.notify_all();
+    }
+}
+
+template<template<typename, typename> class Store>
+void basic_func_scheduler<Store>::take_due(std::vector<unique_task>& batch) {
+    const tp_type now = clock_type::now();
+    const rep_type now_rep = now.time_since_epoch().count();
+#if DTS_FUNC_SCHEDULER_STATS
+    std::size_t depth = 0;
+    for (const auto& sp : shards_) {
+        depth += sp->size.load(std::memory_order_relaxed);
+    }
+    const std::size_t before = batch.size();
+#endif
+    for (const auto& sp : shards_) {
+        shard& s = *sp;
+        if (s.soonest.load() > now_rep && s.first_earliest.load() > now_rep) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lkgrd(s.mtx);
+        const std::size_t taken = batch.size();
+        while (!s.todo.empty()) {
+            if (s.todo.soonest_invoke_time() > now) {
+                // Coalesced with an earlier deadline if its time point has
+                // passed.
+                const job* first = s.todo.peek_first();
+                if (first == nullptr || first->earliest > now) {
+                    break;
+                }
+            }
+            auto info = s.todo.extract_first_info();
+            job& j = info.func();
+            if (j.periodic) {
+                periodic_state* state = j.periodic.get();
+                state->info.emplace(std::move(info));
+                batch.emplace_back(periodic_run(this, state));
+            }
+            else {
+                // earliest, unlike what it was scheduled with, follows
+                // reschedule().
+                j.arm(j.task, this, j.earliest);
+                batch.push_back(std::move(j.task));
+            }
+        }
+        // Before the shard may look empty to wait().
+        in_flight_.fetch_add(batch.size() - taken, std::memory_order_relaxed);
+        publish(s);
+    }
+#if DTS_FUNC_SCHEDULER_STATS
+    // Only when due functions were there to take, not on every wake-up.
+    if (batch.size() != before) {
+        queue_depth_.record(depth);
+    }
+#endif
+}
+
+template<template<typename, typename> class Store>
+void basic_func_scheduler<Store>::dispatch_func() {
+    std::vector<unique_task> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> ulock(mtx_);
+            while (true) {
+                // A timing_wheel may only know a lower bound at first, so the
+                // soonest deadline is read again after every wake-up.
+                const tp_type soonest = soonest_deadline();
+                if (soonest <= clock_type::now()) {
+                    break;
+                }
+                // Functions still running may schedule more, on any shard,
+                // so it takes the destructor, once wait() has returned, to
+                // stop it.
+                if (soonest == tp_type::max() && stopping_ &&
+                    in_flight_.load() == 0) {
+                    return;
+                }
+                // From now on, a sooner function wakes the dispatcher up,
+                // and one published before is seen by reading the shards
+                // again.
+                wake_at_.store(soonest.time_since_epoch().count());
+                if (soonest_deadline() < soonest) {
+                    continue;
+                }
+                if (soonest == tp_type::max()) {
+                    dispatch_cv_.wait(ulock);
+                }
+                else {
+                    dispatch_cv_.wait_until(ulock, soonest);
+                }
+                wake_at_.store(awake);
+            }
+        }
+        take_due(batch);
+        hand_off(batch);
+    }
+}
+
+template<template<typename, typename> class Store>
+std::size_t basic_func_scheduler<Store>::process_expired() {
+    if (!timer_) {
+        throw std::logic_error(
+          "process_expired() needs dispatch_mode::timerfd");
+    }
+    timer_->clear();
+    {
+        // Until the timer is armed again below, scheduling a function doesn't
+        // touch it.
+        std::lock_guard<std::mutex> lkgrd(mtx_);
+        wake_at_.store(awake);
+    }
+    take_due(expired_);
+    const std::size_t cnt = expired_.size();
+    hand_off(expired_);
+    std::lock_guard<std::mutex> lkgrd(mtx_);
+    tp_type soonest;
+    do {
+        // Like the dispatcher before it sleeps, and a passed deadline makes
+        // the timer go off right away.
+        soonest = soonest_deadline();
+        wake_at_.store(soonest.time_since_epoch().count());
+    } while (soonest_deadline() < soonest);
+    if (soonest == tp_type::max()) {
+        timer_->disarm();
+    }
+    else {
+        timer_->arm(soonest.time_since_epoch());
+    }
+    return cnt;
+}
+
+template<template<typename, typename> class Store>
+func_scheduler_stats basic_func_scheduler<Store>::stats() const {
+    func_scheduler_stats result;
+    for (const auto& s : shards_) {
+        result.pending_funcs += s->size.load(std::memory_order_relaxed);
+    }
+    result.in_flight_funcs = in_flight_.load(std::memory_order_relaxed);
+#if DTS_FUNC_SCHEDULER_STATS
+    for (const auto& counters : run_counters_) {
+        result.lateness.merge(counters->lateness.snapshot());
+        result.run_time.merge(counters->run_time.snapshot());
+        result.busy_time += std::chrono::nanoseconds(
+          counters->busy_ns.load(std::memory_order_relaxed));
+    }
+    result.queue_depth = queue_depth_.snapshot();
+#endif
+    return result;
+}
+
+template<template<typename, typename> class Store>
+void basic_func_scheduler<Store>::hand_off(std::vector<unique_task>& batch) {
+    if (ready_ && workers_.empty()) {
+        for (unique_task& task : batch) {
+            task();
+        }
+    }
+    else if (ready_) {
+        // Wakes no more workers than there are functions.
+        ready_->push_bulk(batch);
+    }
+    else {
+        for (unique_task& task : batch) {
+            try {
+                exec_->dispatch(std::move(task));
+            } catch (const thread_pool_stopped&) {
+                // Destroying the task breaks its promise, or drops a
+                // periodic function, and counts it as done.
+                task = unique_task();
+            } catch (const thread_pool_overloaded&) {
+                // Not run on the dispatcher instead, which would hold up
+                // every function due after it.
+                task = unique_task();
+            }
+        }
+    }
+    batch.clear();
+}
+
+template<template<typename, typename> class Store>
+void basic_func_scheduler<Store>::work_func() {
+    while (true) {
+        unique_task task;
+        try {
+            task = ready_->poll();
+        } catch (const thread_pool_stopped&) {
+            break;
+        }
+        task();
+    }
+}
+
+using func_scheduler = basic_func_scheduler<pooled_func_info_map>;
+using wheel_func_scheduler = basic_func_scheduler<timing_wheel>;
+using heap_func_scheduler = basic_func_scheduler<func_info_heap>;
+
+extern template class basic_func_scheduler<pooled_func_info_map>;
+extern template class basic_func_scheduler<timing_wheel>;
+extern template class basic_func_scheduler<func_info_heap>;
+
 }  // namespace dts
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+
+namespace dts {
+
+// When a function scheduled by run_every() runs next.
+enum class periodic_mode {
+    // A period after it was due, keeping the runs on a fixed grid.
+    fixed_rate,
+    // A period after its last run finished.
+    fixed_delay,
+};
+
+// What a fixed-rate function does when a run ends after its next one was due.
+enum class overrun_policy {
+    // Drop the runs that are already due and wait for the next one on the
+    // grid.
+    skip,
+    // Run the missed runs back to back until it's on time again.
+    catch_up,
+};
+
+struct periodic_options {
+    periodic_mode mode = periodic_mode::fixed_rate;
+    // Only used in fixed_rate mode.
+    overrun_policy overrun = overrun_policy::skip;
+    // How late each run may be. Unset uses func_scheduler_options::slack.
+    std::optional<std::chrono::nanoseconds> slack;
+};
+
+// What extracts due functions from the store and hands them over.
+enum class dispatch_mode {
+    // A dispatcher thread of the scheduler's, which sleeps on a condition
+    // variable until the soonest deadline.
+    thread,
+    // The caller, on Linux only. The scheduler arms a timerfd with the soonest
+    // deadline, and the caller's event loop polls its fd() and calls
+    // process_expired() once it's readable.
+    timerfd,
+};
+
+struct func_scheduler_options {
+    /**
+     * Tick length of a timing_wheel backend. Functions run up to one tick
+     * late in exchange for O(1) scheduling. Other backends ignore it.
+     */
+    std::chrono::nanoseconds tick = std::chrono::milliseconds(1);
+
+    /**
+     * How late a function scheduled without a slack of its own may run, like
+     * Linux's timerslack. The dispatcher sleeps until the soonest deadline,
+     * i.e. time point plus slack, and then dispatches every function whose
+     * time point has passed in one batch, so timers close to each other share
+     * a wake-up.
+     */
+    std::chrono::nanoseconds slack = std::chrono::nanoseconds(0);
+
+    /**
+     * Number of shards the pending functions are spread over, each with its
+     * own store and lock. A thread always schedules into the same shard, and
+     * threads are spread over the shards in turn, so producers on different
+     * threads rarely contend. 0 is taken as 1.
+     */
+    std::size_t shards = 1;
+
+    dispatch_mode dispatch = dispatch_mode::thread;
+};
+
+}  // namespace dts
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "latency_histogram.hpp"
+
+/**
+ * Define DTS_FUNC_SCHEDULER_STATS as 0 to compile the histograms out of
+ * func_scheduler. It must have the same value in every translation unit,
+ * which the CMake option of the same name takes care of.
+ */
+#ifndef DTS_FUNC_SCHEDULER_STATS
+#define DTS_FUNC_SCHEDULER_STATS 1
+#endif
+
+namespace dts {
+
+namespace detail {
+class recording_count_histogram;
+}  // namespace detail
+
+/**
+ * A histogram of counts, bucketed like latency_histogram: a percentile is off
+ * by less than 1 / latency_histogram::sub_bucket_count of its value.
+ */
+class count_histogram {
+public:
+    void record(std::uint64_t value, std::uint64_t cnt = 1) noexcept {
+        hist_.record(to_duration(value), cnt);
+    }
+
+    void merge(const count_histogram& other) noexcept {
+        hist_.merge(other.hist_);
+    }
+
+    std::uint64_t count() const noexcept {
+        return hist_.count();
+    }
+
+    bool empty() const noexcept {
+        return hist_.empty();
+    }
+
+    /**
+     * The smallest value that at least p percent of the recorded ones don't
+     * exceed, rounded up to the end of its bucket. 0 if empty.
+     */
+    std::uint64_t percentile(double p) const noexcept {
+        return static_cast<std::uint64_t>(hist_.percentile(p).count());
+    }
+
+    std::uint64_t max() const noexcept {
+        return percentile(100.0);
+    }
+
+private:
+    friend class detail::recording_count_histogram;
+
+    static std::chrono::nanoseconds to_duration(std::uint64_t value) noexcept {
+        constexpr auto limit = static_cast<std::uint64_t>(
+          std::numeric_limits<std::chrono::nanoseconds::rep>::max());
+        return std::chrono::nanoseconds(
+          static_cast<std::chrono::nanoseconds::rep>(std::min(value, limit)));
+    }
+
+    latency_histogram hist_;
+};
+
+/**
+ * A snapshot of a func_scheduler. Functions keep running while it's taken, so
+ * the histograms needn't add up exactly. Every run of a periodic function
+ * counts as a function of its own.
+ */
+struct func_scheduler_stats {
+    // Functions scheduled but not dispatched yet, including periodic ones.
+    std::size_t pending_funcs = 0;
+    // Functions dispatched but not done yet.
+    std::size_t in_flight_funcs = 0;
+    // How long after its time point every function started, measured from
+    // the time point it was last moved to. Includes the slack it was given,
+    // and the time it waited for a worker.
+    latency_histogram lateness;
+    // How long every function ran, i.e. kept a worker busy.
+    latency_histogram run_time;
+    // The sum of run_time.
+    std::chrono::nanoseconds busy_time{ 0 };
+    // The number of pending functions every time due ones were dispatched,
+    // before they were taken.
+    count_histogram queue_depth;
+};
+
+namespace detail {
+
+/**
+ * A latency_histogram any number of threads record into at once. Counters
+ * are relaxed atomics, so recording costs one uncontended increment as long
+ * as the writers keep to histograms of their own.
+ */
+class shared_histogram {
+public:
+    void record(std::chrono::nanoseconds dur) noexcept {
+        counts_[latency_histogram::bucket_of(dur)].fetch_add(
+          1, std::memory_order_relaxed);
+    }
+
+    latency_histogram snapshot() const noexcept {
+        latency_histogram result;
+        for (std::size_t i = 0; i < latency_histogram::bucket_count; ++i) {
+            const std::uint64_t cnt =
+              counts_[i].load(std::memory_order_relaxed);
+            if (cnt != 0) {
+                result.record(latency_histogram::upper_bound_of(i), cnt);
+            }
+        }
+        return result;
+    }
+
+private:
+    std::array<std::atomic<std::uint64_t>, latency_histogram::bucket_count>
+      counts_{};
+};
+
+/**
+ * A count_histogram with a single writer and any number of concurrent
+ * readers, like recording_histogram.
+ */
+class recording_count_histogram {
+public:
+    void record(std::uint64_t value) noexcept {
+        hist_.record(count_histogram::to_duration(value));
+    }
+
+    count_histogram snapshot() const noexcept {
+        count_histogram result;
+        result.hist_ = hist_.snapshot();
+        return result;
+    }
+
+private:
+    recording_histogram hist_;
+};
+
+}  // namespace detail
+
+}  // namespace dts
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+#include "block_pool.hpp"
+
+namespace dts {
+
+/**
+ * A standard allocator handing out single objects from thread_pool's
+ * block_pool, i.e. from a thread-local cache refilled in batches from a
+ * shared free list. Node-based containers such as std::map only allocate one
+ * node at a time, so they stop hitting the heap once the pool has warmed up,
+ * even when nodes are allocated on one thread and freed on another. Arrays
+ * go to ::operator new.
+ *
+ * All pool_allocators compare equal, so nodes may move between containers.
+ */
+template<typename T>
+class pool_allocator {
+public:
+    using value_type = T;
+
+    pool_allocator() noexcept = default;
+
+    template<typename U>
+    pool_allocator(const pool_allocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+                      "T is over-aligned");
+        if (n != 1) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T*>(pool_type::allocate());
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept {
+        if (n != 1) {
+            ::operator delete(p);
+            return;
+        }
+        pool_type::deallocate(p);
+    }
+
+    template<typename U>
+    bool operator==(const pool_allocator<U>&) const noexcept {
+        return true;
+    }
+
+    template<typename U>
+    bool operator!=(const pool_allocator<U>&) const noexcept {
+        return false;
+    }
+
+private:
+    // Rounded like thread_pool's futures, so that similar sizes share a pool.
+    using pool_type = block_pool<(sizeof(T) + 63) / 64 * 64>;
+};
+
+}  // namespace dts
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+
+namespace dts {
+
+/**
+ * A Linux timerfd on CLOCK_MONOTONIC, the clock of std::chrono::steady_clock
+ * there. Its file descriptor becomes readable, e.g. for epoll, once the time
+ * it's armed with has been reached, and stays so until clear() is called.
+ */
+class timer_fd {
+public:
+    // Throws std::system_error if the timer can't be created, or if the
+    // platform has no timerfd.
+    timer_fd();
+    ~timer_fd();
+
+    timer_fd(const timer_fd&) = delete;
+    timer_fd& operator=(const timer_fd&) = delete;
+
+    int fd() const noexcept {
+        return fd_;
+    }
+
+    /**
+     * Expires once steady_clock reaches since_epoch, right away if it already
+     * has. Replaces the time the timer was armed with before.
+     */
+    void arm(std::chrono::nanoseconds since_epoch);
+
+    void disarm();
+
+    // Makes fd() unreadable again. Returns false if the timer hadn't expired.
+    bool clear() noexcept;
+
+private:
+    int fd_ = -1;
+};
+
+}  // namespace dts
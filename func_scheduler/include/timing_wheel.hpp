@@ -0,0 +1,343 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "func_info_map.hpp"
+
+namespace dts {
+
+/**
+ * A hierarchical hashed timing wheel with the interface of func_info_map.
+ *
+ * Time is cut into ticks of a configurable length, counted from the clock's
+ * epoch, and every function is filed under the first tick that isn't before
+ * its time point. Each of the level_count levels has slot_count slots: level k
+ * holds the functions whose tick matches the wheel's cursor in every digit
+ * above k, in base slot_count, and is filed by its k-th digit. Inserting is
+ * O(1). The first non-empty slot of the lowest non-empty level is the soonest
+ * one, and it's cascaded down to lower levels once the clock reaches it, so a
+ * function is moved at most level_count times before it's extracted.
+ *
+ * Functions run at the end of their tick, i.e. up to one tick late, and
+ * functions due in the same tick are extracted in insertion order. Nodes are
+ * kept on a free list and reused, so a warmed-up wheel doesn't allocate, and
+ * erasing or rescheduling a function through its handle is O(1) as well.
+ *
+ * Func must be default constructible and move assignable.
+ */
+template<typename TimePoint, typename Func>
+class timing_wheel {
+public:
+    static_assert(is_time_point<TimePoint>::value,
+                  "TimePoint must be of type std::chrono::time_point");
+    static_assert(std::is_invocable_r<void, Func>::value,
+                  "Func must be invocable without any argument and its return "
+                  "type must be void");
+
+    using tp_type = TimePoint;
+    using func_type = Func;
+    using clock_type = typename tp_type::clock;
+    using duration_type = typename tp_type::duration;
+
+    static constexpr std::size_t slot_bits = 6;
+    static constexpr std::size_t slot_count = std::size_t(1) << slot_bits;
+    // Enough levels to file any 64-bit tick.
+    static constexpr std::size_t level_count =
+      (64 + slot_bits - 1) / slot_bits;
+
+    class node;
+
+    // Identifies a function for erase() and reschedule().
+    struct handle_type {
+        node* n;
+        std::uint64_t id;
+    };
+
+    class func_info {
+    public:
+        func_info(tp_type when, func_type&& func)
+            : when_(when),
+              func_(std::move(func)) {}
+
+        ~func_info() = default;
+
+        func_info(const func_info&) = delete;
+        func_info& operator=(const func_info&) = delete;
+        func_info(func_info&&) = default;
+
+        tp_type when() const noexcept {
+            return when_;
+        }
+
+        func_type& func() noexcept {
+            return func_;
+        }
+
+    private:
+        const tp_type when_;
+        func_type func_;
+    };
+
+    explicit timing_wheel(
+      duration_type tick = std::chrono::milliseconds(1))
+        : tick_(tick.count() > 0 ? tick : duration_type(1)),
+          cursor_(tick_of(clock_type::now())) {}
+
+    ~timing_wheel() = default;
+
+    timing_wheel(const timing_wheel&) = delete;
+    timing_wheel& operator=(const timing_wheel&) = delete;
+
+    duration_type tick() const noexcept {
+        return tick_;
+    }
+
+    std::size_t size() const noexcept {
+        return size_;
+    }
+
+    template<typename Fn>
+    handle_type emplace(tp_type when, Fn&& fn) {
+        node* n = allocate_node();
+        n->id = next_id_++;
+        n->when = when;
+        n->tick = tick_of(when);
+        n->func = func_type(std::forward<Fn>(fn));
+        file(n);
+        ++size_;
+        return handle_type{ n, n->id };
+    }
+
+    // nullptr if the function has already been extracted or erased.
+    func_type* find(const handle_type& handle) {
+        return handle.n->id == handle.id ? &handle.n->func : nullptr;
+    }
+
+    // Returns false if the function has already been extracted or erased.
+    bool erase(const handle_type& handle) {
+        node* n = handle.n;
+        if (n->id != handle.id) {
+            return false;
+        }
+        unlink(n);
+        release_node(n);
+        --size_;
+        return true;
+    }
+
+    /**
+     * Moves a function to another time point in O(1). Returns false if the
+     * function has already been extracted or erased.
+     */
+    bool reschedule(handle_type& handle, tp_type when) {
+        node* n = handle.n;
+        if (n->id != handle.id) {
+            return false;
+        }
+        unlink(n);
+        n->when = when;
+        n->tick = tick_of(when);
+        file(n);
+        return true;
+    }
+
+    bool empty() const noexcept {
+        return size_ == 0;
+    }
+
+    /**
+     * The time of the tick the soonest function is due in. A soonest function
+     * that is filed above level 0 is cascaded once the clock has reached its
+     * slot. Until then, this returns the start of the slot, which is no later
+     * than the function. Must not be called on an empty wheel.
+     */
+    tp_type soonest_invoke_time() {
+        while (true) {
+            std::size_t level = 0;
+            while (masks_[level] == 0) {
+                ++level;
+            }
+            const std::size_t slot = lowest_bit(masks_[level]);
+            const std::uint64_t start = slot_start(level, slot);
+            if (level == 0) {
+                return time_of(start);
+            }
+            const tp_type start_time = time_of(start);
+            if (start_time > clock_type::now()) {
+                return start_time;
+            }
+            cascade(level, slot, start);
+        }
+    }
+
+    /**
+     * The function extract_first_info() would return, or nullptr if no
+     * function is due within the next slot_count ticks. In that case the
+     * soonest one isn't known yet.
+     */
+    const func_type* peek_first() const {
+        if (masks_[0] == 0) {
+            return nullptr;
+        }
+        return &levels_[0][lowest_bit(masks_[0])].head->func;
+    }
+
+    // Must only be called once soonest_invoke_time() has returned a time
+    // that is no later than now, or peek_first() something other than
+    // nullptr.
+    func_info extract_first_info() {
+        const std::size_t slot = lowest_bit(masks_[0]);
+        node* n = levels_[0][slot].head;
+        unlink(n);
+        cursor_ = n->tick > cursor_ ? n->tick : cursor_;
+        const tp_type when = n->when;
+        func_type func = std::move(n->func);
+        release_node(n);
+        --size_;
+        return func_info(when, std::move(func));
+    }
+
+    // Schedules an extracted function again, on a node from the free list.
+    handle_type reinsert(func_info&& info, tp_type when) {
+        return emplace(when, std::move(info.func()));
+    }
+
+    class node {
+        friend class timing_wheel;
+
+        node* prev = nullptr;
+        node* next = nullptr;
+        // 0 while the node is on the free list.
+        std::uint64_t id = 0;
+        std::uint64_t tick = 0;
+        std::uint8_t level = 0;
+        std::uint8_t slot = 0;
+        tp_type when;
+        func_type func;
+    };
+
+private:
+    struct list {
+        node* head = nullptr;
+        node* tail = nullptr;
+    };
+
+    static constexpr std::size_t chunk_size = 256;
+
+    const duration_type tick_;
+    // No function is filed before this tick.
+    std::uint64_t cursor_;
+    std::size_t size_ = 0;
+    std::array<std::uint64_t, level_count> masks_{};
+    std::array<std::array<list, slot_count>, level_count> levels_{};
+    std::vector<std::unique_ptr<node[]>> chunks_;
+    node* free_ = nullptr;
+    std::uint64_t next_id_ = 1;
+
+    static std::size_t lowest_bit(std::uint64_t mask) noexcept {
+        return static_cast<std::size_t>(__builtin_ctzll(mask));
+    }
+
+    std::uint64_t tick_of(tp_type when) const noexcept {
+        const auto since_epoch = when.time_since_epoch();
+        if (since_epoch.count() <= 0) {
+            return 0;
+        }
+        // Rounded up, so that nothing runs before its time point.
+        return static_cast<std::uint64_t>((since_epoch + tick_ -
+                                           duration_type(1)) /
+                                          tick_);
+    }
+
+    tp_type time_of(std::uint64_t tick) const noexcept {
+        return tp_type(tick_ * static_cast<typename duration_type::rep>(tick));
+    }
+
+    // The first tick of a slot that lies ahead of the cursor.
+    std::uint64_t slot_start(std::size_t level,
+                             std::size_t slot) const noexcept {
+        const std::size_t shift = level * slot_bits;
+        if (shift + slot_bits >= 64) {
+            return std::uint64_t(slot) << shift;
+        }
+        const std::uint64_t upper = cursor_ >> (shift + slot_bits)
+                                                << (shift + slot_bits);
+        const std::uint64_t start = upper | (std::uint64_t(slot) << shift);
+        return start > cursor_ ? start : cursor_;
+    }
+
+    void file(node* n) {
+        if (n->tick < cursor_) {
+            n->tick = cursor_;
+        }
+        const std::uint64_t diff = n->tick ^ cursor_;
+        const std::size_t level =
+          diff == 0 ? 0 : (63 - __builtin_clzll(diff)) / slot_bits;
+        const std::size_t slot = (n->tick >> (level * slot_bits)) &
+                                 (slot_count - 1);
+        list& l = levels_[level][slot];
+        n->level = static_cast<std::uint8_t>(level);
+        n->slot = static_cast<std::uint8_t>(slot);
+        n->next = nullptr;
+        n->prev = l.tail;
+        if (l.tail != nullptr) {
+            l.tail->next = n;
+        }
+        else {
+            l.head = n;
+            masks_[level] |= std::uint64_t(1) << slot;
+        }
+        l.tail = n;
+    }
+
+    void unlink(node* n) {
+        list& l = levels_[n->level][n->slot];
+        (n->prev != nullptr ? n->prev->next : l.head) = n->next;
+        (n->next != nullptr ? n->next->prev : l.tail) = n->prev;
+        if (l.head == nullptr) {
+            masks_[n->level] &= ~(std::uint64_t(1) << n->slot);
+        }
+    }
+
+    // Moves the cursor to the start of a slot and refiles its functions.
+    void cascade(std::size_t level, std::size_t slot, std::uint64_t start) {
+        list& l = levels_[level][slot];
+        node* n = l.head;
+        l.head = l.tail = nullptr;
+        masks_[level] &= ~(std::uint64_t(1) << slot);
+        cursor_ = start;
+        while (n != nullptr) {
+            node* next = n->next;
+            file(n);
+            n = next;
+        }
+    }
+
+    node* allocate_node() {
+        if (free_ == nullptr) {
+            chunks_.emplace_back(new node[chunk_size]);
+            node* chunk = chunks_.back().get();
+            for (std::size_t i = 0; i < chunk_size; ++i) {
+                chunk[i].next = free_;
+                free_ = &chunk[i];
+            }
+        }
+        node* n = free_;
+        free_ = n->next;
+        return n;
+    }
+
+    void release_node(node* n) noexcept {
+        n->id = 0;
+        n->func = func_type();
+        n->next = free_;
+        free_ = n;
+    }
+};
+
+}  // namespace dts
@@ -0,0 +1,85 @@
+#include "timer_fd.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+
+#if defined(__linux__)
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+namespace dts {
+
+#if defined(__linux__)
+
+namespace {
+
+void set_time(int fd, std::chrono::nanoseconds since_epoch) {
+    itimerspec spec{};
+    // An it_value of zero would disarm the timer.
+    if (since_epoch.count() <= 0) {
+        since_epoch = std::chrono::nanoseconds(1);
+    }
+    const auto secs = std::chrono::duration_cast<std::chrono::seconds>(
+      since_epoch);
+    spec.it_value.tv_sec = static_cast<time_t>(secs.count());
+    spec.it_value.tv_nsec = static_cast<long>((since_epoch - secs).count());
+    if (timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+        throw std::system_error(errno, std::generic_category(),
+                                "timerfd_settime");
+    }
+}
+
+}  // namespace
+
+timer_fd::timer_fd()
+    : fd_(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) {
+    if (fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(),
+                                "timerfd_create");
+    }
+}
+
+timer_fd::~timer_fd() {
+    close(fd_);
+}
+
+void timer_fd::arm(std::chrono::nanoseconds since_epoch) {
+    set_time(fd_, since_epoch);
+}
+
+void timer_fd::disarm() {
+    itimerspec spec{};
+    if (timerfd_settime(fd_, 0, &spec, nullptr) != 0) {
+        throw std::system_error(errno, std::generic_category(),
+                                "timerfd_settime");
+    }
+}
+
+bool timer_fd::clear() noexcept {
+    std::uint64_t expirations = 0;
+    return read(fd_, &expirations, sizeof(expirations)) ==
+           static_cast<ssize_t>(sizeof(expirations));
+}
+
+#else
+
+timer_fd::timer_fd() {
+    throw std::system_error(std::make_error_code(std::errc::not_supported),
+                            "timerfd");
+}
+
+timer_fd::~timer_fd() = default;
+
+void timer_fd::arm(std::chrono::nanoseconds) {}
+
+void timer_fd::disarm() {}
+
+bool timer_fd::clear() noexcept {
+    return false;
+}
+
+#endif
+
+}  // namespace dts
@@ -1,9 +1,38 @@
 #include "func_scheduler.hpp"
 
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <functional>
 #include <iostream>
+#include <random>
+#include <set>
+
+#include "counting_new.hpp"
+#include "func_info_heap.hpp"
+#include "thread_pool.hpp"
+#include "timing_wheel.hpp"
 
 using dts::func_scheduler;
 
+// A clock that only moves when told to.
+struct manual_clock {
+    using duration = std::chrono::nanoseconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<manual_clock>;
+    static constexpr bool is_steady = true;
+
+    static inline time_point current{ std::chrono::seconds(1) };
+
+    static time_point now() noexcept {
+        return current;
+    }
+};
+
 template<typename T>
 struct duration_unit_string {};
 
@@ -37,8 +66,8 @@ const char* const duration_unit_string<std::chrono::seconds>::unit = "s";
 
 static std::mutex cout_mtx;
 
-template<typename Dur>
-void test_fs(func_scheduler& fs, const std::string& msg, const Dur& dur) {
+template<typename Scheduler, typename Dur>
+void test_fs(Scheduler& fs, const std::string& msg, const Dur& dur) {
     auto before = func_scheduler::clock_type::now();
     auto after_fut = fs.run_after(dur, [] {
         return func_scheduler::clock_type::now();
@@ -54,9 +83,982 @@ void test_fs(func_scheduler& fs, const std::string& msg, const Dur& dur) {
               << duration_unit_string<Dur>::unit << '\n';
 }
 
-int main() {
-    using dts::func_scheduler;
-    func_scheduler fs(std::thread::hardware_concurrency());
+void test_timing_wheel() {
+    std::cout << "test_timing_wheel\n";
+    using tp_type = manual_clock::time_point;
+    using wheel_type = dts::timing_wheel<tp_type, std::function<void()>>;
+    wheel_type wheel(std::chrono::milliseconds(1));
+    assert(wheel.empty());
+
+    // Spread over several levels, with ties.
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<std::int64_t> dist(0, 10'000'000);
+    std::vector<std::int64_t> offsets;
+    for (int i = 0; i < 5000; ++i) {
+        offsets.push_back(dist(gen) >> (i % 24));
+    }
+    std::vector<std::pair<std::int64_t, int>> fired;
+    const tp_type start = manual_clock::now();
+    for (std::size_t i = 0; i < offsets.size(); ++i) {
+        const std::int64_t offset = offsets[i];
+        wheel.emplace(start + std::chrono::microseconds(offset),
+                      [&fired, offset, i] {
+                          fired.emplace_back(offset, static_cast<int>(i));
+                      });
+    }
+    assert(wheel.size() == offsets.size());
+
+    std::int64_t last_tick = -1;
+    while (!wheel.empty()) {
+        const tp_type soonest = wheel.soonest_invoke_time();
+        if (soonest > manual_clock::now()) {
+            manual_clock::current = soonest;
+            continue;
+        }
+        auto info = wheel.extract_first_info();
+        // Never early, and at most one tick late.
+        assert(info.when() <= manual_clock::now());
+        assert(manual_clock::now() - info.when() < wheel.tick());
+        const std::int64_t tick =
+          (manual_clock::now() - start) / wheel.tick();
+        assert(tick >= last_tick);
+        last_tick = tick;
+        info.func()();
+    }
+    assert(fired.size() == offsets.size());
+    // Functions due in the same tick keep their insertion order.
+    for (std::size_t i = 1; i < fired.size(); ++i) {
+        const auto prev_tick = (fired[i - 1].first + 999) / 1000;
+        const auto tick = (fired[i].first + 999) / 1000;
+        assert(prev_tick < tick ||
+               (prev_tick == tick && fired[i - 1].second < fired[i].second));
+    }
+
+    // A function inserted behind a cascaded slot still comes first.
+    const tp_type now = manual_clock::now();
+    int order = 0;
+    int late = 0;
+    int soon = 0;
+    wheel.emplace(now + std::chrono::seconds(10), [&] {
+        late = ++order;
+    });
+    manual_clock::current = now + std::chrono::seconds(1);
+    wheel.emplace(now + std::chrono::seconds(2), [&] {
+        soon = ++order;
+    });
+    while (!wheel.empty()) {
+        manual_clock::current = std::max(manual_clock::current,
+                                         wheel.soonest_invoke_time());
+        if (wheel.soonest_invoke_time() <= manual_clock::now()) {
+            wheel.extract_first_info().func()();
+        }
+    }
+    assert(soon == 1 && late == 2);
+}
+
+// Runs the same random operations on a heap and on func_info_map, which
+// must extract the functions in the same order.
+template<std::size_t Arity>
+void test_func_info_heap_arity() {
+    using tp_type = manual_clock::time_point;
+    using heap_type =
+      dts::func_info_heap<tp_type, std::function<void()>, Arity>;
+    using map_type = dts::func_info_map<tp_type, std::function<void()>>;
+    heap_type heap;
+    map_type map;
+    std::vector<typename heap_type::handle_type> heap_handles;
+    std::vector<typename map_type::handle_type> map_handles;
+    std::vector<int> heap_fired;
+    std::vector<int> map_fired;
+    std::default_random_engine gen(Arity);
+    // Few distinct time points, so that there are many ties.
+    std::uniform_int_distribution<int> time_dist(0, 99);
+    std::uniform_int_distribution<int> op_dist(0, 9);
+    const tp_type start = manual_clock::now();
+    for (int i = 0; i < 5000; ++i) {
+        const int op = op_dist(gen);
+        const tp_type when = start + std::chrono::milliseconds(time_dist(gen));
+        if (op < 7 || heap_handles.empty()) {
+            heap_handles.push_back(heap.emplace(when, [&heap_fired, i] {
+                heap_fired.push_back(i);
+            }));
+            map_handles.push_back(map.emplace(when, [&map_fired, i] {
+                map_fired.push_back(i);
+            }));
+            continue;
+        }
+        std::uniform_int_distribution<std::size_t> handle_dist(
+          0, heap_handles.size() - 1);
+        const std::size_t h = handle_dist(gen);
+        if (op < 8) {
+            const bool erased = heap.erase(heap_handles[h]);
+            assert(erased == map.erase(map_handles[h]));
+            assert(!heap.erase(heap_handles[h]));
+            assert(heap.find(heap_handles[h]) == nullptr);
+        }
+        else if (op < 9) {
+            const bool moved = heap.reschedule(heap_handles[h], when);
+            assert(moved == map.reschedule(map_handles[h], when));
+        }
+        else {
+            // Extract one and put it back later.
+            assert(heap.soonest_invoke_time() == map.soonest_invoke_time());
+            auto heap_info = heap.extract_first_info();
+            auto map_info = map.extract_first_info();
+            heap_handles[h] = heap.reinsert(std::move(heap_info), when);
+            map_handles[h] = map.reinsert(std::move(map_info), when);
+        }
+        assert(heap.size() == map.size());
+    }
+    // Erasing most of them leaves more stale entries than live ones.
+    for (std::size_t h = 0; h < heap_handles.size(); ++h) {
+        if (h % 10 != 0) {
+            assert(heap.erase(heap_handles[h]) ==
+                   map.erase(map_handles[h]));
+        }
+    }
+    assert(heap.size() == map.size());
+    while (!heap.empty()) {
+        assert(heap.soonest_invoke_time() == map.soonest_invoke_time());
+        heap.extract_first_info().func()();
+        map.extract_first_info().func()();
+    }
+    assert(map.empty());
+    assert(heap_fired == map_fired);
+}
+
+void test_func_info_heap() {
+    std::cout << "test_func_info_heap\n";
+    test_func_info_heap_arity<2>();
+    test_func_info_heap_arity<4>();
+    test_func_info_heap_arity<8>();
+}
+
+void test_run_order() {
+    std::cout << "test_run_order\n";
+    dts::wheel_func_scheduler fs(2);
+    std::mutex mtx;
+    std::vector<int> order;
+    std::vector<dts::wheel_func_scheduler::handle<void>> handles;
+    for (int i = 9; i >= 0; --i) {
+        handles.push_back(
+          fs.run_after(std::chrono::milliseconds(20 * i + 20), [&, i] {
+              std::lock_guard<std::mutex> lkgrd(mtx);
+              order.push_back(i);
+          }));
+    }
+    // wait() doesn't run anything ahead of its time.
+    const auto before = func_scheduler::clock_type::now();
+    fs.wait();
+    assert(func_scheduler::clock_type::now() - before >=
+           std::chrono::milliseconds(200));
+    for (auto& handle : handles) {
+        handle.get();
+    }
+    std::lock_guard<std::mutex> lkgrd(mtx);
+    assert(order.size() == 10);
+    for (int i = 0; i < 10; ++i) {
+        assert(order[i] == i);
+    }
+}
+
+template<template<typename, typename> class Store>
+void test_store_cancel(const char* name) {
+    std::cout << name << '\n';
+    using tp_type = manual_clock::time_point;
+    Store<tp_type, std::function<void()>> store;
+    std::vector<int> fired;
+    std::vector<typename decltype(store)::handle_type> handles;
+    const tp_type start = manual_clock::now();
+    for (int i = 0; i < 100; ++i) {
+        handles.push_back(
+          store.emplace(start + std::chrono::milliseconds(10 * (i + 1)),
+                        [&fired, i] {
+                            fired.push_back(i);
+                        }));
+    }
+    // Cancel the odd ones, and move 0 behind everything else.
+    for (int i = 1; i < 100; i += 2) {
+        assert(store.erase(handles[i]));
+        assert(!store.erase(handles[i]));
+    }
+    assert(store.reschedule(handles[0], start + std::chrono::seconds(5)));
+    while (!store.empty()) {
+        const tp_type soonest = store.soonest_invoke_time();
+        if (soonest > manual_clock::now()) {
+            manual_clock::current = soonest;
+            continue;
+        }
+        store.extract_first_info().func()();
+    }
+    assert(fired.size() == 50);
+    for (int i = 0; i < 49; ++i) {
+        assert(fired[i] == 2 * i + 2);
+    }
+    assert(fired.back() == 0);
+    // Extracted functions can't be cancelled or moved any more.
+    assert(!store.erase(handles[2]));
+    assert(!store.reschedule(handles[0], manual_clock::now()));
+}
+
+void test_cancel() {
+    std::cout << "test_cancel\n";
+    test_store_cancel<dts::func_info_map>("func_info_map");
+    test_store_cancel<dts::pooled_func_info_map>("pooled_func_info_map");
+    test_store_cancel<dts::timing_wheel>("timing_wheel");
+    test_store_cancel<dts::func_info_heap>("func_info_heap");
+
+    dts::func_scheduler fs(1);
+    std::atomic<int> ran(0);
+    auto ran_early = fs.run_after(std::chrono::milliseconds(10), [&ran] {
+        return ++ran;
+    });
+    auto cancelled = fs.run_after(std::chrono::hours(1), [&ran] {
+        return ++ran;
+    });
+    auto moved = fs.run_after(std::chrono::hours(1), [&ran] {
+        return ++ran;
+    });
+    assert(ran_early.get() == 1);
+    assert(!ran_early.cancel());
+    assert(cancelled.cancel());
+    assert(!cancelled.cancel());
+    try {
+        cancelled.get();
+        assert(false);
+    } catch (const std::future_error& e) {
+        assert(e.code() == std::future_errc::broken_promise);
+    }
+    assert(moved.reschedule_after(std::chrono::milliseconds(10)));
+    assert(moved.get() == 2);
+    assert(!moved.reschedule_after(std::chrono::milliseconds(10)));
+
+    // Nothing is left to wait for once the rest is cancelled.
+    auto last = fs.run_after(std::chrono::hours(1), [] {});
+    std::thread canceller([&last] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        assert(last.cancel());
+    });
+    fs.wait();
+    canceller.join();
+    assert(ran == 2);
+
+    // Handles that hold no function.
+    func_scheduler::handle<int> empty;
+    assert(!empty.cancel());
+    assert(!empty.reschedule_after(std::chrono::milliseconds(10)));
+    func_scheduler::periodic_handle empty_periodic;
+    assert(!empty_periodic.cancel());
+}
+
+void test_pooled_store() {
+    std::cout << "test_pooled_store\n";
+    using tp_type = manual_clock::time_point;
+    using func_type = std::function<void()>;
+    using store_type = dts::pooled_func_info_map<tp_type, func_type>;
+    static_assert(std::is_same_v<typename store_type::allocator_type,
+                                 dts::pool_allocator<std::pair<
+                                   const store_type::key_type, func_type>>>);
+    store_type store;
+    int fired = 0;
+    auto churn = [&](int cnt) {
+        for (int i = 0; i < cnt; ++i) {
+            store.emplace(manual_clock::now() + std::chrono::milliseconds(i),
+                          [&fired] {
+                              ++fired;
+                          });
+        }
+        while (!store.empty()) {
+            store.extract_first_info().func()();
+        }
+    };
+    churn(1000);
+    // Warmed up, the nodes come back from the pool.
+    const std::size_t before = alloc_cnt.load();
+    churn(1000);
+    assert(alloc_cnt.load() == before);
+    assert(fired == 2000);
+
+    // Nodes freed on another thread go back to the shared free list.
+    std::vector<store_type::func_info> infos;
+    for (int i = 0; i < 1000; ++i) {
+        store.emplace(manual_clock::now(), [] {});
+        infos.push_back(store.extract_first_info());
+    }
+    std::thread([&infos] {
+        infos.clear();
+    }).join();
+    const std::size_t after_exit = alloc_cnt.load();
+    churn(1000);
+    assert(alloc_cnt.load() == after_exit);
+}
+
+template<typename Scheduler>
+void test_periodic_allocations() {
+    Scheduler fs(1);
+    constexpr int run_cnt = 20;
+    std::array<std::size_t, run_cnt> allocs{};
+    std::atomic<int> runs(0);
+    auto handle = fs.run_every(std::chrono::milliseconds(2), [&] {
+        const int i = runs.load();
+        if (i < run_cnt) {
+            allocs[i] = alloc_cnt.load();
+            ++runs;
+        }
+    });
+    while (runs < run_cnt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    assert(handle.cancel());
+    assert(!handle.cancel());
+    // Once warmed up, a run doesn't allocate.
+    assert(allocs[run_cnt - 1] == allocs[2]);
+}
+
+void test_periodic() {
+    std::cout << "test_periodic\n";
+    test_periodic_allocations<dts::func_scheduler>();
+    test_periodic_allocations<dts::wheel_func_scheduler>();
+
+    using clock_type = func_scheduler::clock_type;
+    using namespace std::chrono_literals;
+    // The first run overruns by more than three periods. Returns when the
+    // first five runs started, and when the first one ended. Scheduling
+    // delays only make runs later, so the checks below are lower bounds.
+    auto runs_of = [](dts::overrun_policy overrun,
+                      clock_type::time_point& start,
+                      clock_type::time_point& first_end) {
+        func_scheduler fs(1);
+        std::mutex mtx;
+        std::vector<clock_type::time_point> starts;
+        dts::periodic_options options;
+        options.overrun = overrun;
+        start = clock_type::now();
+        auto handle = fs.run_every(
+          20ms,
+          [&] {
+              std::unique_lock<std::mutex> ulock(mtx);
+              starts.push_back(clock_type::now());
+              if (starts.size() == 1) {
+                  ulock.unlock();
+                  std::this_thread::sleep_for(70ms);
+                  ulock.lock();
+                  first_end = clock_type::now();
+              }
+          },
+          options);
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lkgrd(mtx);
+                if (starts.size() >= 5) {
+                    break;
+                }
+            }
+            std::this_thread::sleep_for(1ms);
+        }
+        assert(handle.cancel());
+        fs.wait();
+        return starts;
+    };
+    clock_type::time_point start;
+    clock_type::time_point first_end;
+    // Runs are due at 20, 40, 60... from start, and none runs early.
+    const auto caught_up =
+      runs_of(dts::overrun_policy::catch_up, start, first_end);
+    for (std::size_t i = 0; i < caught_up.size(); ++i) {
+        assert(caught_up[i] - start >= 20ms * (i + 1));
+    }
+    assert(caught_up[1] >= first_end);
+    // The runs due at 40, 60 and 80ms, during the first one, are dropped.
+    // The second run waits for the first grid point after the first one
+    // ended, which is at 100ms or later.
+    const auto skipped = runs_of(dts::overrun_policy::skip, start, first_end);
+    assert(skipped[1] >= first_end);
+    assert(skipped[1] - start >= 100ms);
+    for (std::size_t i = 2; i < skipped.size(); ++i) {
+        assert(skipped[i] - start >= 20ms * (i + 4));
+    }
+
+    func_scheduler fs(1);
+    std::mutex mtx;
+    std::vector<clock_type::time_point> starts;
+    dts::periodic_options options;
+    options.mode = dts::periodic_mode::fixed_delay;
+    auto handle = fs.run_every(
+      10ms,
+      [&] {
+          {
+              std::lock_guard<std::mutex> lkgrd(mtx);
+              starts.push_back(clock_type::now());
+          }
+          std::this_thread::sleep_for(10ms);
+      },
+      options);
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lkgrd(mtx);
+            if (starts.size() >= 3) {
+                break;
+            }
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    assert(handle.cancel());
+    std::lock_guard<std::mutex> lkgrd(mtx);
+    for (std::size_t i = 1; i < starts.size(); ++i) {
+        assert(starts[i] - starts[i - 1] >= 20ms);
+    }
+}
+
+void test_dispatch() {
+    std::cout << "test_dispatch\n";
+    using namespace std::chrono_literals;
+    constexpr int job_cnt = 1000;
+    const auto when = func_scheduler::clock_type::now() + 50ms;
+    std::atomic<int> ran(0);
+    // All due at once: handed to the workers in one batch.
+    {
+        func_scheduler fs(4);
+        for (int i = 0; i < job_cnt; ++i) {
+            fs.run_at(when, [&ran, when] {
+                assert(func_scheduler::clock_type::now() >= when);
+                ++ran;
+            });
+        }
+        fs.wait();
+        assert(ran == job_cnt);
+    }
+
+    // On a thread_pool, functions and periodic functions run on its workers.
+    dts::thread_pool pool(2);
+    std::mutex mtx;
+    std::set<std::thread::id> threads;
+    auto record = [&] {
+        std::lock_guard<std::mutex> lkgrd(mtx);
+        threads.insert(std::this_thread::get_id());
+    };
+    {
+        func_scheduler fs(pool);
+        std::vector<func_scheduler::handle<int>> handles;
+        for (int i = 0; i < 100; ++i) {
+            handles.push_back(fs.run_after(1ms * (i % 10 + 1), [&, i] {
+                record();
+                return i;
+            }));
+        }
+        std::atomic<int> ticks(0);
+        fs.run_every(2ms, [&] {
+            record();
+            ++ticks;
+        });
+        for (int i = 0; i < 100; ++i) {
+            assert(handles[i].get() == i);
+        }
+        while (ticks < 5) {
+            std::this_thread::sleep_for(1ms);
+        }
+    }
+    assert(threads.count(std::this_thread::get_id()) == 0);
+    assert(!threads.empty() && threads.size() <= 2);
+
+    // Functions the executor accepts but drops unrun, here by shutdown_now(),
+    // are done all the same.
+    {
+        dts::thread_pool dropping(1);
+        std::atomic<bool> started(false);
+        std::atomic<bool> gate(false);
+        dropping.post([&started, &gate] {
+            started = true;
+            while (!gate) {
+                std::this_thread::yield();
+            }
+        });
+        while (!started) {
+            std::this_thread::yield();
+        }
+        func_scheduler fs(dropping);
+        auto dropped = fs.run_after(1ms, [] {});
+        auto token = std::make_shared<int>(0);
+        auto periodic = fs.run_every(1ms, [token] {});
+        while (fs.stats().in_flight_funcs < 2) {
+            std::this_thread::sleep_for(1ms);
+        }
+        std::thread opener([&gate] {
+            std::this_thread::sleep_for(20ms);
+            gate = true;
+        });
+        assert(dropping.shutdown_now() == 2);
+        opener.join();
+        try {
+            dropped.get();
+            assert(false);
+        } catch (const std::future_error& e) {
+            assert(e.code() == std::future_errc::broken_promise);
+        }
+        assert(token.use_count() == 1);
+        assert(!periodic.cancel());
+        fs.wait();
+        assert(fs.stats().in_flight_funcs == 0);
+    }
+
+    // So are functions a full executor rejects.
+    {
+        dts::thread_pool_options options;
+        options.queue_capacity = 2;
+        options.overflow = dts::overflow_policy::reject;
+        dts::thread_pool full(1, options);
+        std::atomic<bool> started(false);
+        std::atomic<bool> gate(false);
+        full.post([&started, &gate] {
+            started = true;
+            while (!gate) {
+                std::this_thread::yield();
+            }
+        });
+        while (!started) {
+            std::this_thread::yield();
+        }
+        func_scheduler fs(full);
+        const auto when = func_scheduler::clock_type::now() + 5ms;
+        std::atomic<int> ran(0);
+        std::vector<func_scheduler::handle<void>> handles;
+        for (int i = 0; i < 20; ++i) {
+            handles.push_back(fs.run_at(when, [&ran] {
+                ++ran;
+            }));
+        }
+        // Only a rejected function is done while the worker is held up.
+        while (fs.stats().pending_funcs != 0 ||
+               fs.stats().in_flight_funcs == 20) {
+            std::this_thread::sleep_for(1ms);
+        }
+        gate = true;
+        int broken = 0;
+        for (auto& h : handles) {
+            try {
+                h.get();
+            } catch (const std::future_error& e) {
+                assert(e.code() == std::future_errc::broken_promise);
+                ++broken;
+            }
+        }
+        fs.wait();
+        assert(broken > 0 && ran + broken == 20);
+    }
+
+    // A function the executor refuses is dropped.
+    pool.shutdown();
+    func_scheduler fs(pool);
+    auto refused = fs.run_after(1ms, [] {});
+    try {
+        refused.get();
+        assert(false);
+    } catch (const std::future_error& e) {
+        assert(e.code() == std::future_errc::broken_promise);
+    }
+    // So is a periodic function, which is released and can't be cancelled
+    // anymore.
+    auto token = std::make_shared<int>(0);
+    auto periodic = fs.run_every(1ms, [token] {});
+    while (token.use_count() > 1) {
+        std::this_thread::sleep_for(1ms);
+    }
+    assert(!periodic.cancel());
+    fs.wait();
+}
+
+// Runs tasks right away on the dispatcher and counts its wake-ups.
+class counting_executor : public dts::executor {
+public:
+    void dispatch(dts::unique_task&& task) override {
+        const auto now = func_scheduler::clock_type::now();
+        if (now - last_ > std::chrono::microseconds(500)) {
+            ++wake_up_cnt;
+        }
+        last_ = now;
+        task();
+    }
+
+    int wake_up_cnt = 0;
+
+private:
+    func_scheduler::clock_type::time_point last_;
+};
+
+void test_slack() {
+    std::cout << "test_slack\n";
+    using clock_type = func_scheduler::clock_type;
+    using namespace std::chrono_literals;
+    constexpr int job_cnt = 200;
+    // One function every 500us over 100ms.
+    auto run = [](std::chrono::nanoseconds slack, bool per_timer) {
+        counting_executor exec;
+        std::atomic<bool> in_time(true);
+        {
+            dts::func_scheduler_options options;
+            if (!per_timer) {
+                options.slack = slack;
+            }
+            func_scheduler fs(exec, options);
+            const auto start = clock_type::now() + 20ms;
+            for (int i = 0; i < job_cnt; ++i) {
+                const auto when = start + 500us * i;
+                // Never early. How late depends on the machine's load, and
+                // slack is covered by the wake-up counts below.
+                auto check = [&in_time, when] {
+                    if (clock_type::now() < when) {
+                        in_time = false;
+                    }
+                };
+                if (per_timer) {
+                    fs.run_at_within(when, slack, check);
+                }
+                else {
+                    fs.run_at(when, check);
+                }
+            }
+        }
+        assert(in_time);
+        return exec.wake_up_cnt;
+    };
+    const int precise = run(0ms, false);
+    const int coalesced = run(25ms, false);
+    const int coalesced_per_timer = run(25ms, true);
+    assert(precise >= 20);
+    assert(coalesced <= 10 && coalesced_per_timer <= 10);
+
+    // Rescheduling keeps the slack, and a negative one is refused.
+    func_scheduler fs(1);
+    auto h = fs.run_after_within(1h, 30ms, [] {
+        return clock_type::now();
+    });
+    const auto when = clock_type::now() + 20ms;
+    assert(h.reschedule(when));
+    const auto ran = h.get();
+    assert(ran >= when && ran <= when + 30ms + 20ms);
+    try {
+        fs.run_after_within(1ms, -1ms, [] {});
+        assert(false);
+    } catch (const std::invalid_argument&) {
+    }
+}
+
+template<typename Scheduler>
+void test_bulk(const char* name) {
+    std::cout << name << '\n';
+    using clock_type = func_scheduler::clock_type;
+    using namespace std::chrono_literals;
+    constexpr int job_cnt = 100;
+    // One worker, so that functions run in the order they're dispatched.
+    Scheduler fs(1);
+    std::mutex mtx;
+    std::vector<int> order;
+    // Given in reverse, so every pair moves the soonest deadline forward.
+    const auto start = clock_type::now() + 50ms;
+    std::vector<std::pair<clock_type::time_point, std::function<int()>>> timers;
+    for (int i = job_cnt - 1; i >= 0; --i) {
+        timers.emplace_back(start + 1ms * i, [&mtx, &order, i] {
+            std::lock_guard<std::mutex> lkgrd(mtx);
+            order.push_back(i);
+            return i;
+        });
+    }
+    auto handles = fs.run_at_bulk(timers.begin(), timers.end());
+    assert(handles.size() == job_cnt);
+    assert(handles[0].cancel());
+    for (int i = 1; i < job_cnt; ++i) {
+        assert(handles[i].get() == job_cnt - 1 - i);
+    }
+    assert(order.size() == job_cnt - 1);
+    assert(std::is_sorted(order.begin(), order.end()));
+
+    // Move-only callables through a move_iterator, counted from now.
+    std::atomic<int> ran(0);
+    auto make_fn = [&ran](int i) {
+        return [&ran, p = std::make_unique<int>(i)] {
+            ran += *p > 0;
+        };
+    };
+    std::vector<std::pair<std::chrono::milliseconds, decltype(make_fn(0))>>
+      delayed;
+    for (int i = 0; i < 10; ++i) {
+        delayed.emplace_back(1ms * (10 - i), make_fn(i + 1));
+    }
+    auto delayed_handles = fs.run_after_bulk(
+      std::make_move_iterator(delayed.begin()),
+      std::make_move_iterator(delayed.end()));
+    for (auto& h : delayed_handles) {
+        h.get();
+    }
+    assert(ran == 10);
+
+    // Nothing is scheduled if a time point has passed.
+    std::vector<std::pair<clock_type::time_point, std::function<void()>>>
+      mixed{ { clock_type::now() + 1ms, [&ran] { ++ran; } },
+             { clock_type::now() - 1ms, [&ran] { ++ran; } } };
+    try {
+        fs.run_at_bulk(mixed.begin(), mixed.end());
+        assert(false);
+    } catch (const std::invalid_argument&) {
+    }
+    std::vector<std::pair<clock_type::time_point, std::function<void()>>>
+      none;
+    assert(fs.run_at_bulk(none.begin(), none.end()).empty());
+    fs.wait();
+    assert(ran == 10);
+}
+
+template<typename Scheduler>
+void test_shards(const char* name) {
+    std::cout << name << '\n';
+    using clock_type = func_scheduler::clock_type;
+    using namespace std::chrono_literals;
+    constexpr int producer_cnt = 8;
+    constexpr int job_cnt = 500;
+    dts::func_scheduler_options options;
+    options.shards = 4;
+    Scheduler fs(2, options);
+    std::atomic<int> ran(0);
+    std::atomic<bool> in_time(true);
+    std::atomic<int> periodic_runs(0);
+    auto periodic = fs.run_every(1ms, [&periodic_runs] {
+        ++periodic_runs;
+    });
+    std::vector<std::thread> producers;
+    for (int p = 0; p < producer_cnt; ++p) {
+        producers.emplace_back([&, p] {
+            std::default_random_engine gen(p);
+            std::uniform_int_distribution<int> delay_dist(1'000, 50'000);
+            std::vector<typename Scheduler::template handle<void>> handles;
+            for (int i = 0; i < job_cnt; ++i) {
+                // Those cancelled or moved below are far enough not to run.
+                const bool far = i % 10 == 0 || i == 1;
+                const auto delay =
+                  far ? std::chrono::microseconds(1h)
+                      : std::chrono::microseconds(delay_dist(gen));
+                const auto when = clock_type::now() + delay;
+                handles.push_back(fs.run_after(delay, [&ran, &in_time, when,
+                                                       i] {
+                    if (i != 1 && clock_type::now() < when) {
+                        in_time = false;
+                    }
+                    ++ran;
+                }));
+            }
+            // Cancel a tenth, from another shard than the one they're in.
+            std::thread([&handles] {
+                for (std::size_t i = 0; i < handles.size(); i += 10) {
+                    assert(handles[i].cancel());
+                }
+            }).join();
+            assert(handles[1].reschedule_after(500us));
+            for (std::size_t i = 0; i < handles.size(); ++i) {
+                if (i % 10 != 0) {
+                    handles[i].get();
+                }
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    assert(periodic.cancel());
+    fs.wait();
+    assert(in_time);
+    assert(ran == producer_cnt * (job_cnt - job_cnt / 10));
+    assert(periodic_runs > 0);
+}
+
+// Functions that running functions schedule during wait() run before it
+// returns, and before the scheduler is destroyed.
+template<typename Scheduler>
+void test_wait_chain(const char* name, std::size_t shards) {
+    std::cout << name << '\n';
+    using namespace std::chrono_literals;
+    constexpr int step_cnt = 3;
+    dts::func_scheduler_options options;
+    options.shards = shards;
+    std::atomic<int> steps(0);
+    {
+        // Outlives the scheduler, which may still run it on destruction.
+        std::function<void()> step;
+        Scheduler fs(1, options);
+        step = [&fs, &steps, &step] {
+            std::this_thread::sleep_for(5ms);
+            if (++steps < step_cnt) {
+                fs.run_after(20ms, step);
+            }
+        };
+        fs.run_after(1ms, step);
+        fs.wait();
+        assert(steps == step_cnt);
+        // And again, through the destructor this time.
+        fs.run_after(1ms, step);
+    }
+    assert(steps == step_cnt + 1);
+    steps = 0;
+    {
+        std::function<void()> step;
+        Scheduler fs(1, options);
+        step = [&fs, &steps, &step] {
+            std::this_thread::sleep_for(5ms);
+            if (++steps < step_cnt) {
+                fs.run_after(20ms, step);
+            }
+        };
+        fs.run_after(1ms, step);
+    }
+    assert(steps == step_cnt);
+}
+
+// Drives the scheduler from an epoll loop, the way an event loop would.
+template<typename Scheduler>
+void test_timerfd(const char* name) {
+    std::cout << name << '\n';
+    using clock_type = func_scheduler::clock_type;
+    using namespace std::chrono_literals;
+    {
+        Scheduler fs(1);
+        assert(fs.fd() == -1);
+        try {
+            fs.process_expired();
+            assert(false);
+        } catch (const std::logic_error&) {
+        }
+    }
+    // Without workers, functions run in the loop.
+    for (std::size_t worker_cnt : { 0, 2 }) {
+        constexpr int job_cnt = 200;
+        dts::func_scheduler_options options;
+        options.dispatch = dts::dispatch_mode::timerfd;
+        options.shards = 2;
+        Scheduler fs(worker_cnt, options);
+        assert(fs.fd() >= 0);
+        std::atomic<bool> stop(false);
+        std::atomic<std::size_t> dispatched(0);
+        std::thread loop([&fs, &stop, &dispatched] {
+            const int epfd = epoll_create1(0);
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            assert(epoll_ctl(epfd, EPOLL_CTL_ADD, fs.fd(), &ev) == 0);
+            while (!stop) {
+                if (epoll_wait(epfd, &ev, 1, 10) == 1) {
+                    dispatched += fs.process_expired();
+                }
+            }
+            close(epfd);
+        });
+        const auto loop_id = loop.get_id();
+        std::atomic<bool> in_time(true);
+        std::atomic<bool> in_loop(true);
+        std::atomic<int> ticks(0);
+        auto periodic = fs.run_every(2ms, [&ticks] {
+            ++ticks;
+        });
+        // Arms the timer sooner than it was.
+        auto moved = fs.run_after(1h, [] {
+            return -1;
+        });
+        auto cancelled = fs.run_after(1h, [] {
+            return -2;
+        });
+        std::vector<typename Scheduler::template handle<int>> handles;
+        for (int i = 0; i < job_cnt; ++i) {
+            const auto delay = 1ms + 50us * (job_cnt - i);
+            const auto when = clock_type::now() + delay;
+            handles.push_back(
+              fs.run_after(delay, [&in_time, &in_loop, loop_id, when, i] {
+                  if (clock_type::now() < when) {
+                      in_time = false;
+                  }
+                  if (std::this_thread::get_id() != loop_id) {
+                      in_loop = false;
+                  }
+                  return i;
+              }));
+        }
+        assert(moved.reschedule_after(500us));
+        assert(cancelled.cancel());
+        for (int i = 0; i < job_cnt; ++i) {
+            assert(handles[i].get() == i);
+        }
+        assert(moved.get() == -1);
+        while (ticks < 3) {
+            std::this_thread::sleep_for(1ms);
+        }
+        assert(periodic.cancel());
+        fs.wait();
+        stop = true;
+        loop.join();
+        assert(in_time);
+        assert(in_loop == (worker_cnt == 0));
+        assert(dispatched >= static_cast<std::size_t>(job_cnt + 1 + ticks));
+    }
+}
+
+void test_stats() {
+    std::cout << "test_stats\n";
+    using namespace std::chrono_literals;
+    constexpr int job_cnt = 100;
+    dts::func_scheduler_options options;
+    options.shards = 2;
+    func_scheduler fs(2, options);
+    auto far = fs.run_after(1h, [] {});
+    std::vector<func_scheduler::handle<void>> handles;
+    for (int i = 0; i < job_cnt; ++i) {
+        handles.push_back(fs.run_after(1ms + 10us * i, [] {
+            std::this_thread::sleep_for(100us);
+        }));
+    }
+    dts::func_scheduler_stats stats = fs.stats();
+    assert(stats.pending_funcs + stats.in_flight_funcs +
+             stats.lateness.count() >=
+           job_cnt + 1);
+    for (auto& h : handles) {
+        h.get();
+    }
+    std::atomic<int> ticks(0);
+    auto periodic = fs.run_every(1ms, [&ticks] {
+        ++ticks;
+    });
+    while (ticks < 3) {
+        std::this_thread::sleep_for(1ms);
+    }
+    assert(periodic.cancel());
+    assert(far.cancel());
+    fs.wait();
+    stats = fs.stats();
+    assert(stats.pending_funcs == 0);
+    assert(stats.in_flight_funcs == 0);
+#if DTS_FUNC_SCHEDULER_STATS
+    const auto runs = static_cast<std::uint64_t>(job_cnt + ticks);
+    assert(stats.lateness.count() == runs);
+    assert(stats.run_time.count() == runs);
+    assert(stats.run_time.percentile(50) >= 100us);
+    assert(stats.busy_time >= job_cnt * 100us);
+    assert(!stats.queue_depth.empty());
+    assert(stats.queue_depth.max() >= 1);
+    // Rounded up to the end of its bucket.
+    assert(stats.queue_depth.max() < 2 * job_cnt);
+    // Counted from the time point a function was moved to.
+    func_scheduler moved_fs(1);
+    auto moved = moved_fs.run_after(5ms, [] {});
+    assert(moved.reschedule_after(300ms));
+    moved.get();
+    stats = moved_fs.stats();
+    assert(stats.lateness.count() == 1);
+    assert(stats.lateness.max() < 250ms);
+    // Taken once, whatever woke the dispatcher up before.
+    assert(stats.queue_depth.count() == 1);
+#else
+    assert(stats.lateness.empty());
+#endif
+}
+
+template<typename Scheduler>
+void test_delays(const char* name) {
+    std::cout << name << '\n';
+    Scheduler fs(std::thread::hardware_concurrency());
     auto delay = std::chrono::milliseconds(1000);
     std::vector<std::thread> tests;
 
@@ -80,6 +1082,34 @@ int main() {
     for (std::thread& test : tests) {
         test.join();
     }
+}
+
+int main() {
+    test_timing_wheel();
+    test_func_info_heap();
+    test_run_order();
+    test_cancel();
+    test_pooled_store();
+    test_periodic();
+    test_dispatch();
+    test_slack();
+    test_bulk<dts::func_scheduler>("test_bulk func_scheduler");
+    test_bulk<dts::wheel_func_scheduler>("test_bulk wheel_func_scheduler");
+    test_bulk<dts::heap_func_scheduler>("test_bulk heap_func_scheduler");
+    test_shards<dts::func_scheduler>("test_shards func_scheduler");
+    test_shards<dts::wheel_func_scheduler>("test_shards wheel_func_scheduler");
+    test_wait_chain<dts::func_scheduler>("test_wait_chain", 1);
+    test_wait_chain<dts::func_scheduler>("test_wait_chain sharded", 4);
+    test_wait_chain<dts::wheel_func_scheduler>(
+      "test_wait_chain sharded wheel_func_scheduler", 4);
+    test_wait_chain<dts::heap_func_scheduler>(
+      "test_wait_chain sharded heap_func_scheduler", 4);
+    test_timerfd<dts::func_scheduler>("test_timerfd func_scheduler");
+    test_timerfd<dts::wheel_func_scheduler>(
+      "test_timerfd wheel_func_scheduler");
+    test_stats();
+    test_delays<dts::func_scheduler>("func_scheduler");
+    test_delays<dts::wheel_func_scheduler>("wheel_func_scheduler");
 
     return 0;
 }
\ No newline at end of file
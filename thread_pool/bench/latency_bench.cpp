@@ -0,0 +1,96 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using dts::thread_pool;
+using dts::thread_pool_options;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr std::size_t burst_cnt = 2000;
+constexpr std::size_t burst_size = 8;
+constexpr std::chrono::microseconds burst_gap(200);
+
+double percentile(const std::vector<double>& sorted, double p) {
+    const auto idx = static_cast<std::size_t>(p * (sorted.size() - 1));
+    return sorted[idx];
+}
+
+/**
+ * Submits short bursts separated by idle gaps, long enough for workers to go
+ * idle, and records the time from submission to the start of every task.
+ */
+void bench(const char* name, thread_pool::size_type worker_cnt,
+           const thread_pool_options& options) {
+    std::vector<double> latencies(burst_cnt * burst_size);
+    {
+        thread_pool pool(worker_cnt, options);
+        std::atomic<std::size_t> done(0);
+        for (std::size_t b = 0; b < burst_cnt; ++b) {
+            for (std::size_t i = 0; i < burst_size; ++i) {
+                double* latency = &latencies[b * burst_size + i];
+                const auto submitted = clock_type::now();
+                pool.post([latency, submitted, &done]() {
+                    const std::chrono::duration<double, std::micro> elapsed =
+                      clock_type::now() - submitted;
+                    *latency = elapsed.count();
+                    done.fetch_add(1, std::memory_order_release);
+                });
+            }
+            while (done.load(std::memory_order_acquire) <
+                   (b + 1) * burst_size) {
+                std::this_thread::yield();
+            }
+            std::this_thread::sleep_for(burst_gap);
+        }
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::printf("%-16s %10.2f %10.2f %10.2f %10.2f\n", name,
+                percentile(latencies, 0.5), percentile(latencies, 0.9),
+                percentile(latencies, 0.99), percentile(latencies, 0.999));
+}
+
+}  // namespace
+
+int main() {
+    const thread_pool::size_type worker_cnt =
+      std::max(2u, std::thread::hardware_concurrency());
+
+    thread_pool_options park;
+
+    thread_pool_options spin;
+    spin.spin_count = 1 << 14;
+
+    thread_pool_options spin_yield = spin;
+    spin_yield.yield_count = 64;
+
+    thread_pool_options adaptive = spin_yield;
+    adaptive.adaptive_spin = true;
+
+    std::printf("%zu workers, %zu bursts of %zu tasks, %lld us apart\n",
+                worker_cnt, burst_cnt, burst_size,
+                static_cast<long long>(burst_gap.count()));
+    std::printf("submit-to-start latency in us\n");
+    std::printf("%-16s %10s %10s %10s %10s\n", "", "p50", "p90", "p99",
+                "p99.9");
+    for (bool work_stealing : { false, true }) {
+        std::printf("%s\n", work_stealing ? "work stealing" : "shared queue");
+        for (thread_pool_options* options :
+             { &park, &spin, &spin_yield, &adaptive }) {
+            options->work_stealing = work_stealing;
+        }
+        bench("park", worker_cnt, park);
+        bench("spin", worker_cnt, spin);
+        bench("spin+yield", worker_cnt, spin_yield);
+        bench("adaptive", worker_cnt, adaptive);
+    }
+
+    return 0;
+}
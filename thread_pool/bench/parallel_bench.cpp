@@ -0,0 +1,105 @@
+#include "parallel_algorithm.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <vector>
+
+#ifdef DTS_BENCH_STD_PAR
+#include <execution>
+#endif
+
+using dts::thread_pool;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr std::size_t elem_cnt = 1 << 24;
+constexpr int repeat_cnt = 5;
+
+template<typename Fn>
+double best_ms(Fn&& fn) {
+    double best = 0;
+    for (int i = 0; i < repeat_cnt; ++i) {
+        const auto start = clock_type::now();
+        fn();
+        const std::chrono::duration<double, std::milli> elapsed =
+          clock_type::now() - start;
+        if (i == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+    return best;
+}
+
+double work(double v) {
+    return std::sqrt(v) * std::sin(v);
+}
+
+}  // namespace
+
+int main() {
+    std::vector<double> in(elem_cnt);
+    std::iota(in.begin(), in.end(), 0.0);
+    std::vector<double> out(elem_cnt);
+    volatile double sink = 0;
+
+    thread_pool pool(std::max(1u, std::thread::hardware_concurrency()));
+    std::printf("%zu elements, %zu workers, best of %d runs in ms\n", elem_cnt,
+                pool.worker_count(), repeat_cnt);
+    std::printf("%-12s %12s %12s %12s\n", "", "for_each", "reduce",
+                "transform");
+
+    std::printf(
+      "%-12s %12.2f %12.2f %12.2f\n", "serial", best_ms([&]() {
+          for (double& v : out) {
+              v = work(v);
+          }
+      }),
+      best_ms([&]() {
+          sink = std::transform_reduce(in.begin(), in.end(), 0.0,
+                                       std::plus<>(), work);
+      }),
+      best_ms([&]() {
+          std::transform(in.begin(), in.end(), out.begin(), work);
+      }));
+
+    std::printf(
+      "%-12s %12.2f %12.2f %12.2f\n", "dts", best_ms([&]() {
+          dts::parallel_for(pool, out.begin(), out.end(), 4096,
+                            [](double& v) {
+                                v = work(v);
+                            });
+      }),
+      best_ms([&]() {
+          sink = dts::parallel_reduce(pool, in.begin(), in.end(), 4096, 0.0,
+                                      std::plus<>(), work);
+      }),
+      best_ms([&]() {
+          dts::parallel_transform(pool, in.begin(), in.end(), out.begin(),
+                                  4096, work);
+      }));
+
+#ifdef DTS_BENCH_STD_PAR
+    std::printf(
+      "%-12s %12.2f %12.2f %12.2f\n", "std::par", best_ms([&]() {
+          std::for_each(std::execution::par, out.begin(), out.end(),
+                        [](double& v) {
+                            v = work(v);
+                        });
+      }),
+      best_ms([&]() {
+          sink = std::transform_reduce(std::execution::par, in.begin(),
+                                       in.end(), 0.0, std::plus<>(), work);
+      }),
+      best_ms([&]() {
+          std::transform(std::execution::par, in.begin(), in.end(),
+                         out.begin(), work);
+      }));
+#endif
+
+    return 0;
+}
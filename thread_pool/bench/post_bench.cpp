@@ -0,0 +1,67 @@
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using dts::thread_pool;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr std::size_t task_cnt = 1 << 18;
+
+void wait_until(const std::atomic<std::size_t>& cnt, std::size_t target) {
+    while (cnt.load(std::memory_order_acquire) < target) {
+        std::this_thread::yield();
+    }
+}
+
+// Returns nanoseconds per task, from the first enqueue to the last completion.
+template<typename Enqueue>
+double bench(thread_pool::size_type worker_cnt, Enqueue enqueue) {
+    std::atomic<std::size_t> done(0);
+    thread_pool pool(worker_cnt);
+    const auto start = clock_type::now();
+    for (std::size_t i = 0; i < task_cnt; ++i) {
+        enqueue(pool, done);
+    }
+    wait_until(done, task_cnt);
+    const std::chrono::duration<double, std::nano> elapsed =
+      clock_type::now() - start;
+    return elapsed.count() / task_cnt;
+}
+
+}  // namespace
+
+int main() {
+    auto post = [](thread_pool& pool, std::atomic<std::size_t>& done) {
+        pool.post([&done]() {
+            done.fetch_add(1, std::memory_order_release);
+        });
+    };
+    auto submit = [](thread_pool& pool, std::atomic<std::size_t>& done) {
+        // The future is dropped right away, as fire-and-forget callers do.
+        pool.submit([&done]() {
+            done.fetch_add(1, std::memory_order_release);
+        });
+    };
+
+    const thread_pool::size_type hw_cnt =
+      std::max(1u, std::thread::hardware_concurrency());
+    std::vector<thread_pool::size_type> worker_cnts{ 1, 4 };
+    if (hw_cnt != 1 && hw_cnt != 4) {
+        worker_cnts.push_back(hw_cnt);
+    }
+
+    std::printf("%zu tasks per run, ns per task\n", task_cnt);
+    std::printf("%8s %12s %12s\n", "workers", "post", "submit");
+    for (thread_pool::size_type n : worker_cnts) {
+        std::printf("%8zu %12.1f %12.1f\n", n, bench(n, post),
+                    bench(n, submit));
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using dts::thread_pool;
+using dts::thread_pool_options;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr std::size_t task_cnt = 1 << 18;
+
+// Returns nanoseconds per posted task, from the first post to the last run.
+double bench(thread_pool::size_type worker_cnt,
+             const thread_pool_options& options) {
+    std::atomic<std::size_t> done(0);
+    thread_pool pool(worker_cnt, options);
+    const auto start = clock_type::now();
+    for (std::size_t i = 0; i < task_cnt; ++i) {
+        pool.post([&done]() {
+            done.fetch_add(1, std::memory_order_relaxed);
+        });
+    }
+    pool.wait_idle();
+    const std::chrono::duration<double, std::nano> elapsed =
+      clock_type::now() - start;
+    return elapsed.count() / task_cnt;
+}
+
+}  // namespace
+
+/**
+ * Built twice: stats_bench with the statistics compiled in and
+ * stats_bench_off without, which gives the baseline.
+ */
+int main() {
+    std::vector<std::pair<const char*, thread_pool_options>> configs;
+#if DTS_THREAD_POOL_STATS
+    configs.emplace_back("counters", thread_pool_options());
+    thread_pool_options histograms;
+    histograms.latency_histograms = true;
+    configs.emplace_back("histograms", histograms);
+    thread_pool_options hooks;
+    std::atomic<std::size_t> hook_cnt(0);
+    hooks.on_task_start = [&hook_cnt](std::size_t) {
+        hook_cnt.fetch_add(1, std::memory_order_relaxed);
+    };
+    hooks.on_task_end = [&hook_cnt](std::size_t, std::chrono::nanoseconds) {
+        hook_cnt.fetch_add(1, std::memory_order_relaxed);
+    };
+    configs.emplace_back("hooks", hooks);
+#else
+    configs.emplace_back("compiled out", thread_pool_options());
+#endif
+
+    const thread_pool::size_type hw_cnt =
+      std::max(1u, std::thread::hardware_concurrency());
+    std::vector<thread_pool::size_type> worker_cnts{ 1, 4 };
+    if (hw_cnt != 1 && hw_cnt != 4) {
+        worker_cnts.push_back(hw_cnt);
+    }
+
+    std::printf("%zu posted tasks per run, ns per task\n", task_cnt);
+    std::printf("%14s", "workers");
+    for (thread_pool::size_type n : worker_cnts) {
+        std::printf(" %8zu", n);
+    }
+    std::printf("\n");
+    for (const auto& [name, options] : configs) {
+        std::printf("%14s", name);
+        for (thread_pool::size_type n : worker_cnts) {
+            std::printf(" %8.1f", bench(n, options));
+        }
+        std::printf("\n");
+    }
+
+    return 0;
+}
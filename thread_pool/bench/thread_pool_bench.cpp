@@ -0,0 +1,89 @@
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using dts::thread_pool;
+using dts::thread_pool_options;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr std::size_t root_cnt = 64;
+constexpr std::size_t leaf_cnt = 4096;
+constexpr std::size_t total_cnt = root_cnt * (leaf_cnt + 1);
+
+void wait_until(const std::atomic<std::size_t>& cnt, std::size_t target) {
+    while (cnt.load(std::memory_order_acquire) < target) {
+        std::this_thread::yield();
+    }
+}
+
+// All tasks are submitted from outside of the pool.
+double bench_external(thread_pool::size_type worker_cnt,
+                      const thread_pool_options& options) {
+    std::atomic<std::size_t> done(0);
+    thread_pool pool(worker_cnt, options);
+    const auto start = clock_type::now();
+    for (std::size_t i = 0; i < total_cnt; ++i) {
+        pool.submit([&done]() {
+            done.fetch_add(1, std::memory_order_release);
+        });
+    }
+    wait_until(done, total_cnt);
+    const std::chrono::duration<double> elapsed = clock_type::now() - start;
+    return total_cnt / elapsed.count();
+}
+
+// Every root task fans out leaf tasks from inside a worker.
+double bench_fan_out(thread_pool::size_type worker_cnt,
+                     const thread_pool_options& options) {
+    std::atomic<std::size_t> done(0);
+    thread_pool pool(worker_cnt, options);
+    const auto start = clock_type::now();
+    for (std::size_t i = 0; i < root_cnt; ++i) {
+        pool.submit([&pool, &done]() {
+            for (std::size_t j = 0; j < leaf_cnt; ++j) {
+                pool.submit([&done]() {
+                    done.fetch_add(1, std::memory_order_release);
+                });
+            }
+            done.fetch_add(1, std::memory_order_release);
+        });
+    }
+    wait_until(done, total_cnt);
+    const std::chrono::duration<double> elapsed = clock_type::now() - start;
+    return total_cnt / elapsed.count();
+}
+
+}  // namespace
+
+int main() {
+    thread_pool_options shared;
+    thread_pool_options stealing;
+    stealing.work_stealing = true;
+
+    const thread_pool::size_type max_worker_cnt =
+      std::max(1u, std::thread::hardware_concurrency());
+    std::vector<thread_pool::size_type> worker_cnts;
+    for (thread_pool::size_type n = 1; n < max_worker_cnt; n <<= 1) {
+        worker_cnts.push_back(n);
+    }
+    worker_cnts.push_back(max_worker_cnt);
+
+    std::printf("%zu tasks per run, throughput in Mtasks/s\n", total_cnt);
+    std::printf("%8s %18s %18s %18s %18s\n", "workers", "external/shared",
+                "external/stealing", "fan-out/shared", "fan-out/stealing");
+    for (thread_pool::size_type n : worker_cnts) {
+        std::printf("%8zu %18.3f %18.3f %18.3f %18.3f\n", n,
+                    bench_external(n, shared) / 1e6,
+                    bench_external(n, stealing) / 1e6,
+                    bench_fan_out(n, shared) / 1e6,
+                    bench_fan_out(n, stealing) / 1e6);
+    }
+
+    return 0;
+}
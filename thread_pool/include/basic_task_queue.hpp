@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "task_priority.hpp"
+#include "unique_task.hpp"
+
+namespace dts {
+
+/**
+ * The interface thread_pool uses to talk to its shared queue, so that the
+ * backend can be picked at construction time.
+ *
+ * poll() blocks until a task is available and throws thread_pool_stopped
+ * once stop_push() has been called and the queue is empty, or when it's
+ * retired by retire_pollers().
+ *
+ * Tasks are polled from the highest-priority non-empty lane, except that a
+ * lower lane passed over starvation_limit times in a row is served next.
+ */
+class basic_task_queue {
+public:
+    using task_type = unique_task;
+    using value_type = task_type;
+    using size_type = std::size_t;
+
+    basic_task_queue() = default;
+    virtual ~basic_task_queue() = default;
+
+    basic_task_queue(const basic_task_queue&) = delete;
+    basic_task_queue& operator=(const basic_task_queue&) = delete;
+
+    void push(task_type&& task) {
+        push(std::move(task), task_priority::normal);
+    }
+
+    virtual void push(task_type&& task, task_priority priority) = 0;
+
+    /**
+     * Pushes task unless it would have to wait for room first, in which case
+     * task is left untouched and false is returned. Unbounded queues always
+     * have room.
+     */
+    virtual bool try_push(task_type& task, task_priority priority) {
+        push(std::move(task), priority);
+        return true;
+    }
+
+    void push_bulk(std::vector<task_type>& tasks) {
+        push_bulk(tasks, task_priority::normal);
+    }
+
+    // Moves every task out of tasks.
+    virtual void push_bulk(std::vector<task_type>& tasks,
+                           task_priority priority) = 0;
+
+    virtual task_type poll() = 0;
+
+    // Like poll() but returns std::nullopt if no task arrives in time.
+    virtual std::optional<task_type> poll_for(
+      std::chrono::nanoseconds timeout) = 0;
+
+    // Non-blocking poll. Returns std::nullopt if the queue is empty.
+    virtual std::optional<task_type> try_poll() = 0;
+
+    virtual bool empty() = 0;
+
+    // Whether the lane of priority is empty. Doesn't lock.
+    virtual bool empty(task_priority priority) = 0;
+
+    virtual void stop_push() = 0;
+
+    /**
+     * Makes the next cnt calls to poll() or poll_for() throw
+     * thread_pool_stopped even if tasks are queued, waking blocked pollers.
+     * Lets the pool retire some of its workers the way stop_push() retires
+     * all of them.
+     */
+    virtual void retire_pollers(size_type cnt) = 0;
+};
+
+}  // namespace dts
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+namespace dts {
+
+/**
+ * A process-wide free list of fixed-size memory blocks.
+ *
+ * Every thread keeps a small local cache so that allocate() and deallocate()
+ * don't take any lock in the common case. A thread whose cache grows too
+ * large hands a batch of blocks back to the shared list, and a thread whose
+ * cache runs dry refills a batch from there before falling back to
+ * ::operator new. This keeps producer/consumer patterns, where blocks are
+ * allocated on one thread and freed on another, free of heap allocations once
+ * the pool has warmed up.
+ *
+ * Blocks are never returned to the system.
+ */
+template<std::size_t BlockSize>
+class block_pool {
+public:
+    static_assert(BlockSize >= sizeof(void*), "BlockSize is too small");
+
+    static constexpr std::size_t block_size = BlockSize;
+    static constexpr std::size_t batch_size = 64;
+
+    block_pool() = delete;
+
+    static void* allocate() {
+        local_cache& cache = local();
+        if (cache.head == nullptr) {
+            refill(cache);
+            if (cache.head == nullptr) {
+                return ::operator new(block_size);
+            }
+        }
+        node* n = cache.head;
+        cache.head = n->next;
+        --cache.cnt;
+        return n;
+    }
+
+    static void deallocate(void* p) noexcept {
+        local_cache& cache = local();
+        node* n = static_cast<node*>(p);
+        if (cache.dead) {
+            // This thread's cache has already been flushed.
+            global_list& global = shared();
+            std::lock_guard<std::mutex> lkgrd(global.mtx);
+            n->next = global.head;
+            global.head = n;
+            return;
+        }
+        n->next = cache.head;
+        cache.head = n;
+        if (++cache.cnt >= 2 * batch_size) {
+            flush(cache, batch_size);
+        }
+    }
+
+private:
+    struct node {
+        node* next;
+    };
+
+    // Trivially destructible so that it stays usable during thread exit.
+    struct local_cache {
+        node* head;
+        std::size_t cnt;
+        bool dead;
+    };
+
+    struct local_cache_guard {
+        ~local_cache_guard() {
+            local_cache& cache = cache_;
+            flush(cache, cache.cnt);
+            cache.dead = true;
+        }
+    };
+
+    struct global_list {
+        std::mutex mtx;
+        node* head = nullptr;
+    };
+
+    static inline thread_local local_cache cache_{ nullptr, 0, false };
+
+    static local_cache& local() noexcept {
+        // Registers the flush at thread exit on first use in this thread.
+        static thread_local local_cache_guard guard;
+        (void)guard;
+        return cache_;
+    }
+
+    static global_list& shared() noexcept {
+        // Leaked on purpose: blocks may be released after static destruction.
+        static global_list* const global = new global_list;
+        return *global;
+    }
+
+    static void refill(local_cache& cache) {
+        global_list& global = shared();
+        std::lock_guard<std::mutex> lkgrd(global.mtx);
+        while (global.head != nullptr && cache.cnt < batch_size) {
+            node* n = global.head;
+            global.head = n->next;
+            n->next = cache.head;
+            cache.head = n;
+            ++cache.cnt;
+        }
+    }
+
+    static void flush(local_cache& cache, std::size_t cnt) noexcept {
+        if (cnt == 0) {
+            return;
+        }
+        // Detach cnt blocks from the local cache before taking the lock.
+        node* first = cache.head;
+        node* last = first;
+        for (std::size_t i = 1; i < cnt; ++i) {
+            last = last->next;
+        }
+        cache.head = last->next;
+        cache.cnt -= cnt;
+
+        global_list& global = shared();
+        std::lock_guard<std::mutex> lkgrd(global.mtx);
+        last->next = global.head;
+        global.head = first;
+    }
+};
+
+}  // namespace dts
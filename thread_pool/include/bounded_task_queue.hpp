@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+#include "basic_task_queue.hpp"
+#include "event_count.hpp"
+#include "mpmc_ring.hpp"
+#include "thread_pool_options.hpp"
+
+namespace dts {
+
+/**
+ * A bounded queue on top of a lock-free mpmc_ring. Pushes and polls that
+ * succeed right away never take a lock. Only pollers that find the ring empty,
+ * and producers that find it full under overflow_policy::block, park on a
+ * condition variable.
+ *
+ * stop_push() waits for producers that are in the middle of a push, so that
+ * pollers and the pool see every task that made it in.
+ *
+ * Every priority lane is a ring of its own with the full capacity, so the
+ * queue holds up to task_priority_count times that many tasks in all. Lane
+ * starvation is tracked with relaxed counters, so under contention the limit
+ * is approximate.
+ */
+class bounded_task_queue final : public basic_task_queue {
+public:
+    bounded_task_queue(size_type capacity, overflow_policy overflow,
+                       size_type starvation_limit = 16);
+    ~bounded_task_queue() override = default;
+
+    using basic_task_queue::push;
+    using basic_task_queue::push_bulk;
+
+    void push(task_type&& task, task_priority priority) override;
+
+    bool try_push(task_type& task, task_priority priority) override;
+
+    void push_bulk(std::vector<task_type>& tasks,
+                   task_priority priority) override;
+
+    task_type poll() override;
+
+    std::optional<task_type> poll_for(
+      std::chrono::nanoseconds timeout) override;
+
+    std::optional<task_type> try_poll() override;
+
+    bool empty() override;
+
+    bool empty(task_priority priority) override;
+
+    void stop_push() override;
+
+    void retire_pollers(size_type cnt) override;
+
+    // The most tasks the queue holds, over all lanes.
+    size_type capacity() const noexcept {
+        return rings_[0].capacity() * task_priority_count;
+    }
+
+    size_type lane_capacity() const noexcept {
+        return rings_[0].capacity();
+    }
+
+private:
+    using ring_type = mpmc_ring<task_type>;
+
+    const overflow_policy overflow_;
+    const size_type starvation_limit_;
+    std::atomic<bool> accept_push_;
+    // Producers between checking accept_push_ and returning from the ring.
+    std::atomic<size_type> pushing_;
+    // Pending retire_pollers() requests.
+    std::atomic<size_type> retire_cnt_;
+    std::array<ring_type, task_priority_count> rings_;
+    // Polls served from other lanes while a lane was waiting.
+    std::array<std::atomic<size_type>, task_priority_count> skipped_;
+    event_count pollers_;
+    event_count producers_;
+
+    /**
+     * Pushes task according to overflow_. Counts successful pushes that
+     * pollers_ hasn't been notified about in unnotified. Under
+     * overflow_policy::run_in_caller the task may run right here instead, in
+     * which case its exceptions propagate to the caller.
+     */
+    void push_one(task_type& task, ring_type& ring, size_type& unnotified);
+
+    /**
+     * Pushes task to ring once, and returns false if it's full. Throws
+     * thread_pool_stopped after stop_push().
+     */
+    bool push_if_accepted(task_type& task, ring_type& ring);
+
+    /**
+     * Waits for producers that saw accept_push_ set to finish their push, so
+     * that whatever they pushed is in the rings. Doesn't wait for producers
+     * that are blocked or running a task in the caller.
+     */
+    void await_producers() noexcept;
+
+    /**
+     * Shared by poll() and poll_for(). wait(ready) blocks until ready() may
+     * have become true and returns false if it timed out instead.
+     */
+    template<typename Wait>
+    std::optional<task_type> poll_with(Wait&& wait);
+
+    bool claim_retirement() noexcept;
+};
+
+}  // namespace dts
@@ -0,0 +1,254 @@
+#pragma once
+
+#if !defined(__cpp_impl_coroutine)
+#error "coroutine.hpp needs a C++20 compiler with coroutine support"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "future.hpp"
+#include "thread_pool.hpp"
+
+namespace dts {
+
+template<typename T>
+class task;
+
+namespace detail {
+
+class task_promise_base {
+public:
+    // Resumes whoever awaits the task on the thread that finished it.
+    struct final_awaiter {
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(
+          std::coroutine_handle<Promise> handle) noexcept {
+            std::coroutine_handle<> continuation =
+              handle.promise().continuation();
+            if (continuation) {
+                return continuation;
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept {
+        return {};
+    }
+
+    final_awaiter final_suspend() const noexcept {
+        return {};
+    }
+
+    void unhandled_exception() noexcept {
+        error_ = std::current_exception();
+    }
+
+    std::coroutine_handle<> continuation() const noexcept {
+        return continuation_;
+    }
+
+    void set_continuation(std::coroutine_handle<> continuation) noexcept {
+        continuation_ = continuation;
+    }
+
+protected:
+    void rethrow_if_failed() const {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+private:
+    std::coroutine_handle<> continuation_;
+    std::exception_ptr error_;
+};
+
+template<typename T>
+class task_promise_type : public task_promise_base {
+public:
+    task<T> get_return_object() noexcept;
+
+    template<typename U>
+    void return_value(U&& value) {
+        value_.emplace(std::forward<U>(value));
+    }
+
+    T result() {
+        rethrow_if_failed();
+        return std::move(*value_);
+    }
+
+private:
+    std::optional<T> value_;
+};
+
+template<>
+class task_promise_type<void> : public task_promise_base {
+public:
+    task<void> get_return_object() noexcept;
+
+    void return_void() noexcept {}
+
+    void result() {
+        rethrow_if_failed();
+    }
+};
+
+}  // namespace detail
+
+/**
+ * A lazily started coroutine producing a T, which must not be a reference.
+ * It starts when awaited and runs on the awaiting thread until it hops onto
+ * a pool with co_await pool.schedule(). When it finishes, the awaiting
+ * coroutine is resumed right there by symmetric transfer, on whichever
+ * worker finished it, without going through the queue again.
+ */
+template<typename T>
+class [[nodiscard]] task {
+public:
+    using promise_type = detail::task_promise_type<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    static_assert(!std::is_reference_v<T>, "T must not be a reference");
+
+    task() noexcept : handle_() {}
+
+    explicit task(handle_type handle) noexcept : handle_(handle) {}
+
+    ~task() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    task(task&& other) noexcept
+        : handle_(std::exchange(other.handle_, nullptr)) {}
+
+    task& operator=(task&& other) noexcept {
+        if (this != &other) {
+            task(std::move(other)).swap(*this);
+        }
+        return *this;
+    }
+
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+
+    void swap(task& other) noexcept {
+        std::swap(handle_, other.handle_);
+    }
+
+    bool valid() const noexcept {
+        return static_cast<bool>(handle_);
+    }
+
+    // Awaiting starts the task; the result is its value or exception.
+    auto operator co_await() && noexcept {
+        struct awaiter {
+            handle_type handle;
+
+            bool await_ready() const noexcept {
+                return !handle || handle.done();
+            }
+
+            std::coroutine_handle<> await_suspend(
+              std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().set_continuation(awaiting);
+                return handle;
+            }
+
+            T await_resume() {
+                if (!handle) {
+                    throw std::future_error(std::future_errc::no_state);
+                }
+                return handle.promise().result();
+            }
+        };
+        return awaiter{ handle_ };
+    }
+
+private:
+    handle_type handle_;
+};
+
+namespace detail {
+
+template<typename T>
+task<T> task_promise_type<T>::get_return_object() noexcept {
+    return task<T>(
+      std::coroutine_handle<task_promise_type>::from_promise(*this));
+}
+
+inline task<void> task_promise_type<void>::get_return_object() noexcept {
+    return task<void>(
+      std::coroutine_handle<task_promise_type>::from_promise(*this));
+}
+
+// Starts right away and frees itself once done.
+struct detached_coroutine {
+    struct promise_type {
+        detached_coroutine get_return_object() const noexcept {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() const noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() const noexcept {
+            return {};
+        }
+
+        void return_void() const noexcept {}
+
+        void unhandled_exception() const noexcept {
+            std::terminate();
+        }
+    };
+};
+
+// Owns prom, so that the waiter may go as soon as the result is set.
+template<typename T>
+detached_coroutine complete_into(task<T> t, promise<T> prom) {
+    try {
+        if constexpr (std::is_void_v<T>) {
+            co_await std::move(t);
+            prom.set_value();
+        }
+        else {
+            prom.set_value(co_await std::move(t));
+        }
+    } catch (...) {
+        prom.set_exception(std::current_exception());
+    }
+}
+
+}  // namespace detail
+
+/**
+ * Runs t and blocks the calling thread until it has finished, returning its
+ * value or rethrowing its exception. Only the caller blocks: t runs on the
+ * caller until it hops onto a pool, and the pool's workers only ever see
+ * queued resumptions. Must not be called from a worker that t depends on.
+ */
+template<typename T>
+T sync_wait(task<T> t) {
+    promise<T> prom;
+    future<T> result = prom.get_future();
+    detail::complete_into(std::move(t), std::move(prom));
+    return result.get();
+}
+
+}  // namespace dts
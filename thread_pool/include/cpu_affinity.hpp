@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+
+namespace dts {
+
+// The CPUs this process may run on, in ascending order.
+std::vector<int> allowed_cpus();
+
+/**
+ * Restricts the calling thread to cpus. Returns false if the kernel refused or
+ * the platform doesn't support it.
+ */
+bool pin_current_thread(const std::vector<int>& cpus) noexcept;
+
+// The CPU the calling thread is running on, or -1 if that's unknown.
+int current_cpu() noexcept;
+
+}  // namespace dts
@@ -0,0 +1,14 @@
+#pragma once
+
+namespace dts {
+
+// Tells the CPU that the calling thread is busy-waiting.
+inline void cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield");
+#endif
+}
+
+}  // namespace dts
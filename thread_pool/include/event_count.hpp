@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace dts {
+
+/**
+ * Lets threads sleep until a condition that is updated without any lock, such
+ * as a lock-free queue becoming non-empty, may have become true.
+ *
+ * A waiter registers itself before it checks the condition, and a notifier
+ * publishes its update before it looks for waiters. The seq_cst fences on both
+ * sides guarantee that either the waiter sees the update or the notifier sees
+ * the waiter, so no wake-up is lost. Notifying without any waiter costs a
+ * fence and a load.
+ */
+class event_count {
+public:
+    using size_type = std::size_t;
+
+    event_count() = default;
+    ~event_count() = default;
+
+    event_count(const event_count&) = delete;
+    event_count& operator=(const event_count&) = delete;
+
+    // Returns right away if ready() is true, otherwise sleeps until notified.
+    template<typename Pred>
+    void wait(Pred&& ready) {
+        std::unique_lock<std::mutex> ulock(mtx_);
+        const std::uint64_t epoch = epoch_;
+        waiting_cnt_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ready()) {
+            cv_.wait(ulock, [this, epoch]() {
+                return epoch_ != epoch;
+            });
+        }
+        waiting_cnt_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Like wait() but gives up at deadline. Returns false if it timed out.
+    template<typename Pred, typename Clock, typename Dur>
+    bool wait_until(Pred&& ready,
+                    const std::chrono::time_point<Clock, Dur>& deadline) {
+        std::unique_lock<std::mutex> ulock(mtx_);
+        const std::uint64_t epoch = epoch_;
+        waiting_cnt_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool notified = true;
+        if (!ready()) {
+            notified = cv_.wait_until(ulock, deadline, [this, epoch]() {
+                return epoch_ != epoch;
+            });
+        }
+        waiting_cnt_.fetch_sub(1, std::memory_order_relaxed);
+        return notified;
+    }
+
+    // Wakes up to cnt waiters.
+    void notify(size_type cnt) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const size_type waiting_cnt =
+          waiting_cnt_.load(std::memory_order_relaxed);
+        if (waiting_cnt == 0 || cnt == 0) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lkgrd(mtx_);
+            ++epoch_;
+        }
+        if (cnt >= waiting_cnt) {
+            cv_.notify_all();
+            return;
+        }
+        while (cnt--) {
+            cv_.notify_one();
+        }
+    }
+
+    void notify_all() {
+        {
+            std::lock_guard<std::mutex> lkgrd(mtx_);
+            ++epoch_;
+        }
+        cv_.notify_all();
+    }
+
+    size_type waiting_count() const noexcept {
+        return waiting_cnt_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::atomic<size_type> waiting_cnt_{ 0 };
+    // Bumped under mtx_ on every notification.
+    std::uint64_t epoch_ = 0;
+};
+
+}  // namespace dts
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "unique_task.hpp"
+
+namespace dts {
+
+/**
+ * Something that runs tasks, such as a thread_pool. Futures bound to an
+ * executor run their continuations on it; see future::then().
+ */
+class executor {
+public:
+    virtual ~executor() = default;
+
+    // Runs task at some point. Throws, e.g. thread_pool_stopped, if it can't.
+    virtual void dispatch(unique_task&& task) = 0;
+};
+
+}  // namespace dts
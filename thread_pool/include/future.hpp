@@ -0,0 +1,554 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "block_pool.hpp"
+#include "executor.hpp"
+#include "thread_pool_stopped.hpp"
+#include "unique_task.hpp"
+
+namespace dts {
+
+template<typename R>
+class future;
+
+template<typename R>
+class promise;
+
+namespace detail {
+
+template<typename R>
+class task_promise;
+
+struct future_access;
+
+struct void_result {};
+
+template<typename T>
+using pool_for = block_pool<(sizeof(T) + 63) / 64 * 64>;
+
+/**
+ * The state shared by a promise and its future. It is reference counted and
+ * allocated from a block_pool so that a promise/future pair doesn't hit the
+ * heap once the pool has warmed up.
+ */
+template<typename R>
+class shared_state {
+public:
+    using value_type = std::conditional_t<
+      std::is_void_v<R>, void_result,
+      std::conditional_t<std::is_reference_v<R>, std::remove_reference_t<R>*,
+                         R>>;
+
+    static shared_state* create() {
+        static_assert(alignof(shared_state) <=
+                        __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+                      "shared_state is over-aligned");
+        void* p = pool_for<shared_state>::allocate();
+        return ::new (p) shared_state();
+    }
+
+    shared_state(const shared_state&) = delete;
+    shared_state& operator=(const shared_state&) = delete;
+
+    void add_ref() noexcept {
+        refcnt_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release() noexcept {
+        if (refcnt_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->~shared_state();
+            pool_for<shared_state>::deallocate(this);
+        }
+    }
+
+    template<typename... Args>
+    void set_value(Args&&... args) {
+        complete([&]() {
+            if constexpr (std::is_reference_v<R>) {
+                value_.emplace(std::addressof(args)...);
+            }
+            else {
+                value_.emplace(std::forward<Args>(args)...);
+            }
+        });
+    }
+
+    void set_exception(std::exception_ptr error) {
+        complete([&]() {
+            error_ = std::move(error);
+        });
+    }
+
+    bool satisfied() noexcept {
+        std::lock_guard<std::mutex> lkgrd(mtx_);
+        return satisfied_;
+    }
+
+    bool is_ready() const noexcept {
+        return ready_.load(std::memory_order_acquire);
+    }
+
+    void wait() {
+        if (is_ready()) {
+            return;
+        }
+        std::unique_lock<std::mutex> ulock(mtx_);
+        cv_.wait(ulock, [this]() {
+            return satisfied_;
+        });
+    }
+
+    template<typename Clock, typename Dur>
+    bool wait_until(const std::chrono::time_point<Clock, Dur>& when) {
+        if (is_ready()) {
+            return true;
+        }
+        std::unique_lock<std::mutex> ulock(mtx_);
+        return cv_.wait_until(ulock, when, [this]() {
+            return satisfied_;
+        });
+    }
+
+    /**
+     * Runs continuation once the state is satisfied, or right away if it
+     * already is. It's dispatched to ex, or invoked on the satisfying thread
+     * if ex is null. A state holds at most one continuation.
+     */
+    void set_continuation(executor* ex, unique_task&& continuation) {
+        {
+            std::lock_guard<std::mutex> lkgrd(mtx_);
+            if (!satisfied_) {
+                continuation_executor_ = ex;
+                continuation_ = std::move(continuation);
+                return;
+            }
+        }
+        run_continuation(ex, continuation);
+    }
+
+    // Must only be called once the state is ready.
+    R take() {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+        if constexpr (std::is_void_v<R>) {
+            return;
+        }
+        else if constexpr (std::is_reference_v<R>) {
+            return **value_;
+        }
+        else {
+            return std::move(*value_);
+        }
+    }
+
+private:
+    std::atomic<int> refcnt_;
+    std::atomic<bool> ready_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool satisfied_;
+    std::optional<value_type> value_;
+    std::exception_ptr error_;
+    executor* continuation_executor_;
+    unique_task continuation_;
+
+    shared_state()
+        : refcnt_(1),
+          ready_(false),
+          mtx_(),
+          cv_(),
+          satisfied_(false),
+          value_(),
+          error_(),
+          continuation_executor_(nullptr),
+          continuation_() {}
+
+    ~shared_state() = default;
+
+    template<typename Store>
+    void complete(Store&& store) {
+        unique_task continuation;
+        {
+            std::lock_guard<std::mutex> lkgrd(mtx_);
+            if (satisfied_) {
+                throw std::future_error(
+                  std::future_errc::promise_already_satisfied);
+            }
+            store();
+            satisfied_ = true;
+            ready_.store(true, std::memory_order_release);
+            continuation = std::move(continuation_);
+        }
+        cv_.notify_all();
+        if (continuation) {
+            run_continuation(continuation_executor_, continuation);
+        }
+    }
+
+    static void run_continuation(executor* ex,
+                                 unique_task& continuation) noexcept {
+        if (ex == nullptr) {
+            std::invoke(continuation);
+            return;
+        }
+        try {
+            ex->dispatch(std::move(continuation));
+        } catch (...) {
+            // Continuations hold a task_promise, which reports the drop.
+        }
+    }
+};
+
+// Owns one reference to a shared_state.
+template<typename R>
+class state_handle {
+public:
+    state_handle() noexcept : state_(nullptr) {}
+
+    explicit state_handle(shared_state<R>* state) noexcept : state_(state) {}
+
+    ~state_handle() {
+        reset();
+    }
+
+    state_handle(state_handle&& other) noexcept
+        : state_(std::exchange(other.state_, nullptr)) {}
+
+    state_handle& operator=(state_handle&& other) noexcept {
+        if (this != &other) {
+            reset();
+            state_ = std::exchange(other.state_, nullptr);
+        }
+        return *this;
+    }
+
+    state_handle(const state_handle&) = delete;
+    state_handle& operator=(const state_handle&) = delete;
+
+    shared_state<R>* operator->() const noexcept {
+        return state_;
+    }
+
+    shared_state<R>* get() const noexcept {
+        return state_;
+    }
+
+    explicit operator bool() const noexcept {
+        return state_ != nullptr;
+    }
+
+    void reset() noexcept {
+        if (state_ != nullptr) {
+            std::exchange(state_, nullptr)->release();
+        }
+    }
+
+private:
+    shared_state<R>* state_;
+};
+
+}  // namespace detail
+
+/**
+ * A lightweight counterpart of std::future. Its shared state comes from a
+ * block_pool instead of the heap.
+ *
+ * A future can be bound to an executor, as the futures returned by
+ * thread_pool::submit() are bound to their pool, in which case continuations
+ * added with then() run there.
+ */
+template<typename R>
+class future {
+public:
+    future() noexcept = default;
+    ~future() = default;
+
+    future(future&&) noexcept = default;
+    future& operator=(future&&) noexcept = default;
+
+    future(const future&) = delete;
+    future& operator=(const future&) = delete;
+
+    bool valid() const noexcept {
+        return static_cast<bool>(state_);
+    }
+
+    bool is_ready() const {
+        check_state();
+        return state_->is_ready();
+    }
+
+    void wait() const {
+        check_state();
+        state_->wait();
+    }
+
+    template<typename Rep, typename Period>
+    std::future_status wait_for(
+      const std::chrono::duration<Rep, Period>& dur) const {
+        return wait_until(std::chrono::steady_clock::now() + dur);
+    }
+
+    template<typename Clock, typename Dur>
+    std::future_status wait_until(
+      const std::chrono::time_point<Clock, Dur>& when) const {
+        check_state();
+        return state_->wait_until(when) ? std::future_status::ready :
+                                          std::future_status::timeout;
+    }
+
+    // Waits for the result and invalidates this future, like std::future.
+    R get() {
+        check_state();
+        detail::state_handle<R> state(std::move(state_));
+        state->wait();
+        return state->take();
+    }
+
+    // The executor continuations run on, or nullptr.
+    executor* bound_executor() const noexcept {
+        return executor_;
+    }
+
+    // Binds this future to ex; see then().
+    future via(executor& ex) && {
+        executor_ = &ex;
+        return std::move(*this);
+    }
+
+    /**
+     * Calls fn(f) once this future is ready, where f is this future, and
+     * returns a future for its result. Nobody waits in between: fn is
+     * dispatched to the bound executor when the result is set, or right away
+     * if it already is. Without a bound executor fn runs on the thread that
+     * sets the result, or on the calling thread if it's already set.
+     *
+     * Invalidates this future. The returned one is bound to the same
+     * executor. If the executor doesn't accept fn, e.g. because it's a
+     * stopped thread_pool, the returned future gets thread_pool_stopped.
+     */
+    template<typename Fn>
+    future<std::invoke_result_t<std::decay_t<Fn>&, future>> then(Fn&& fn) {
+        return then_on(executor_, std::forward<Fn>(fn));
+    }
+
+    // Like then(fn) but dispatches fn to ex and binds the result to it.
+    template<typename Fn>
+    future<std::invoke_result_t<std::decay_t<Fn>&, future>> then(executor& ex,
+                                                                 Fn&& fn) {
+        return then_on(&ex, std::forward<Fn>(fn));
+    }
+
+private:
+    template<typename>
+    friend class future;
+    friend class promise<R>;
+    friend struct detail::future_access;
+
+    detail::state_handle<R> state_;
+    executor* executor_ = nullptr;
+
+    explicit future(detail::shared_state<R>* state) noexcept : state_(state) {}
+
+    template<typename Fn>
+    future<std::invoke_result_t<std::decay_t<Fn>&, future>> then_on(
+      executor* ex, Fn&& fn) {
+        using fn_res_t = std::invoke_result_t<std::decay_t<Fn>&, future>;
+        check_state();
+        detail::shared_state<R>* state = state_.get();
+        detail::task_promise<fn_res_t> prom;
+        future<fn_res_t> result = prom.get_future();
+        result.executor_ = ex;
+        // The continuation owns this future until it hands it to fn.
+        unique_task continuation(
+          [prom = std::move(prom), fn = std::forward<Fn>(fn),
+           antecedent = std::move(*this)]() mutable {
+              prom.fulfill([&]() -> fn_res_t {
+                  return std::invoke(fn, std::move(antecedent));
+              });
+          });
+        state->set_continuation(ex, std::move(continuation));
+        return result;
+    }
+
+    void check_state() const {
+        if (!state_) {
+            throw std::future_error(std::future_errc::no_state);
+        }
+    }
+};
+
+/**
+ * A lightweight counterpart of std::promise. Destroying a promise that hasn't
+ * been satisfied stores std::future_errc::broken_promise.
+ */
+template<typename R>
+class promise {
+public:
+    promise()
+        : state_(detail::shared_state<R>::create()),
+          future_retrieved_(false) {}
+
+    ~promise() {
+        if (state_ && !state_->satisfied()) {
+            state_->set_exception(std::make_exception_ptr(
+              std::future_error(std::future_errc::broken_promise)));
+        }
+    }
+
+    promise(promise&& other) noexcept
+        : state_(std::move(other.state_)),
+          future_retrieved_(other.future_retrieved_) {}
+
+    promise& operator=(promise&& other) noexcept {
+        if (this != &other) {
+            promise(std::move(other)).swap(*this);
+        }
+        return *this;
+    }
+
+    promise(const promise&) = delete;
+    promise& operator=(const promise&) = delete;
+
+    void swap(promise& other) noexcept {
+        std::swap(state_, other.state_);
+        std::swap(future_retrieved_, other.future_retrieved_);
+    }
+
+    future<R> get_future() {
+        check_state();
+        if (future_retrieved_) {
+            throw std::future_error(
+              std::future_errc::future_already_retrieved);
+        }
+        future_retrieved_ = true;
+        state_->add_ref();
+        return future<R>(state_.get());
+    }
+
+    template<typename... Args>
+    void set_value(Args&&... args) {
+        check_state();
+        state_->set_value(std::forward<Args>(args)...);
+    }
+
+    void set_exception(std::exception_ptr error) {
+        check_state();
+        state_->set_exception(std::move(error));
+    }
+
+private:
+    detail::state_handle<R> state_;
+    bool future_retrieved_;
+
+    void check_state() const {
+        if (!state_) {
+            throw std::future_error(std::future_errc::no_state);
+        }
+    }
+};
+
+namespace detail {
+
+// Backport of C++20 std::unwrap_ref_decay_t.
+template<typename T>
+struct unwrap_reference {
+    using type = T;
+};
+
+template<typename T>
+struct unwrap_reference<std::reference_wrapper<T>> {
+    using type = T&;
+};
+
+template<typename T>
+using unwrap_ref_decay_t = typename unwrap_reference<std::decay_t<T>>::type;
+
+/**
+ * The result of calling a decay copy of Fn with args stored by
+ * std::make_tuple, i.e. std::reference_wrapper unwrapped, as lvalues. Matches
+ * what std::bind would return.
+ */
+template<typename Fn, typename... Args>
+using bound_result_t =
+  std::invoke_result_t<std::decay_t<Fn>&,
+                       unwrap_ref_decay_t<Args>&...>;
+
+// Invokes fn and stores its result or exception into prom.
+template<typename R, typename Fn>
+void fulfill(promise<R>& prom, Fn&& fn) {
+    try {
+        if constexpr (std::is_void_v<R>) {
+            std::invoke(std::forward<Fn>(fn));
+            prom.set_value();
+        }
+        else {
+            prom.set_value(std::invoke(std::forward<Fn>(fn)));
+        }
+    } catch (...) {
+        prom.set_exception(std::current_exception());
+    }
+}
+
+/**
+ * The promise of a submitted task. If the task is destroyed without having
+ * run, e.g. by thread_pool::shutdown_now(), its future gets
+ * thread_pool_stopped instead of std::future_errc::broken_promise.
+ */
+template<typename R>
+class task_promise {
+public:
+    task_promise() : prom_(), fulfilled_(false) {}
+
+    ~task_promise() {
+        if (!fulfilled_) {
+            prom_.set_exception(std::make_exception_ptr(thread_pool_stopped(
+              "The task was dropped by a stopping thread_pool.")));
+        }
+    }
+
+    task_promise(task_promise&& other) noexcept
+        : prom_(std::move(other.prom_)),
+          fulfilled_(std::exchange(other.fulfilled_, true)) {}
+
+    task_promise& operator=(task_promise&&) = delete;
+
+    future<R> get_future() {
+        return prom_.get_future();
+    }
+
+    // Invokes fn and stores its result or exception.
+    template<typename Fn>
+    void fulfill(Fn&& fn) {
+        fulfilled_ = true;
+        detail::fulfill(prom_, std::forward<Fn>(fn));
+    }
+
+private:
+    promise<R> prom_;
+    bool fulfilled_;
+};
+
+// Lets when_all() and when_any() watch futures without consuming them.
+struct future_access {
+    template<typename R>
+    static void on_ready(future<R>& f, unique_task&& fn) {
+        f.check_state();
+        f.state_->set_continuation(nullptr, std::move(fn));
+    }
+};
+
+}  // namespace detail
+
+}  // namespace dts
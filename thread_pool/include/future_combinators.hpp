@@ -0,0 +1,205 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "future.hpp"
+
+namespace dts {
+
+// The result of when_any(): every input, and the index of one that's ready.
+template<typename Sequence>
+struct when_any_result {
+    std::size_t index;
+    Sequence futures;
+};
+
+namespace detail {
+
+template<typename T>
+struct is_future : std::false_type {};
+
+template<typename R>
+struct is_future<future<R>> : std::true_type {};
+
+/**
+ * Shared by the continuations when_all() attaches to its inputs. remaining
+ * starts one above the input count so that the result can't be set before
+ * every continuation has been attached.
+ */
+template<typename Sequence>
+struct when_all_state {
+    when_all_state(Sequence&& inputs, std::size_t input_cnt)
+        : futures(std::move(inputs)), remaining(input_cnt + 1), prom() {}
+
+    Sequence futures;
+    std::atomic<std::size_t> remaining;
+    promise<Sequence> prom;
+
+    void arrive() noexcept {
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            prom.set_value(std::move(futures));
+        }
+    }
+};
+
+// Like when_all_state, but the first ready input is all it waits for.
+template<typename Sequence>
+struct when_any_state {
+    when_any_state(Sequence&& inputs, std::size_t input_cnt)
+        : futures(std::move(inputs)),
+          remaining(input_cnt == 0 ? 1 : 2),
+          index(static_cast<std::size_t>(-1)),
+          claimed(false),
+          prom() {}
+
+    Sequence futures;
+    std::atomic<std::size_t> remaining;
+    std::size_t index;
+    std::atomic<bool> claimed;
+    promise<when_any_result<Sequence>> prom;
+
+    void ready(std::size_t i) noexcept {
+        if (!claimed.exchange(true, std::memory_order_acq_rel)) {
+            index = i;
+            arrive();
+        }
+    }
+
+    void arrive() noexcept {
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            prom.set_value(
+              when_any_result<Sequence>{ index, std::move(futures) });
+        }
+    }
+};
+
+template<typename R>
+future<R> bind_to(future<R>&& f, executor* ex) {
+    if (ex == nullptr) {
+        return std::move(f);
+    }
+    return std::move(f).via(*ex);
+}
+
+template<typename InputIt>
+using future_vector_t =
+  std::vector<typename std::iterator_traits<InputIt>::value_type>;
+
+template<typename InputIt>
+using enable_if_iterator_t = std::enable_if_t<
+  !is_future<std::decay_t<InputIt>>::value &&
+  is_future<typename std::iterator_traits<InputIt>::value_type>::value>;
+
+}  // namespace detail
+
+/**
+ * Returns a future that becomes ready, holding the inputs, once every input
+ * is ready. Nothing blocks meanwhile: each input gets a continuation that
+ * counts down. The result is bound to the executor of the first input, so
+ * then() on it runs on the same pool.
+ *
+ * Moves the futures out of [first, last).
+ */
+template<typename InputIt, typename = detail::enable_if_iterator_t<InputIt>>
+future<detail::future_vector_t<InputIt>> when_all(InputIt first,
+                                                  InputIt last) {
+    using sequence_type = detail::future_vector_t<InputIt>;
+    sequence_type futures(std::make_move_iterator(first),
+                          std::make_move_iterator(last));
+    const std::size_t input_cnt = futures.size();
+    executor* ex = input_cnt == 0 ? nullptr : futures.front().bound_executor();
+    auto state = std::make_shared<detail::when_all_state<sequence_type>>(
+      std::move(futures), input_cnt);
+    auto result = detail::bind_to(state->prom.get_future(), ex);
+    for (std::size_t i = 0; i < input_cnt; ++i) {
+        detail::future_access::on_ready(state->futures[i], [state]() {
+            state->arrive();
+        });
+    }
+    state->arrive();
+    return result;
+}
+
+template<typename... Rs>
+future<std::tuple<future<Rs>...>> when_all(future<Rs>... futures) {
+    using sequence_type = std::tuple<future<Rs>...>;
+    executor* ex = nullptr;
+    if constexpr (sizeof...(Rs) != 0) {
+        ex = std::get<0>(std::tie(futures...)).bound_executor();
+    }
+    auto state = std::make_shared<detail::when_all_state<sequence_type>>(
+      sequence_type(std::move(futures)...), sizeof...(Rs));
+    auto result = detail::bind_to(state->prom.get_future(), ex);
+    std::apply(
+      [&state](auto&... inputs) {
+          (detail::future_access::on_ready(inputs,
+                                           [state]() {
+                                               state->arrive();
+                                           }),
+           ...);
+      },
+      state->futures);
+    state->arrive();
+    return result;
+}
+
+/**
+ * Returns a future that becomes ready as soon as one input is ready. It holds
+ * all inputs and the index of that one, or index -1 if there are no inputs.
+ * Bound like the result of when_all().
+ *
+ * Moves the futures out of [first, last).
+ */
+template<typename InputIt, typename = detail::enable_if_iterator_t<InputIt>>
+future<when_any_result<detail::future_vector_t<InputIt>>> when_any(
+  InputIt first, InputIt last) {
+    using sequence_type = detail::future_vector_t<InputIt>;
+    sequence_type futures(std::make_move_iterator(first),
+                          std::make_move_iterator(last));
+    const std::size_t input_cnt = futures.size();
+    executor* ex = input_cnt == 0 ? nullptr : futures.front().bound_executor();
+    auto state = std::make_shared<detail::when_any_state<sequence_type>>(
+      std::move(futures), input_cnt);
+    auto result = detail::bind_to(state->prom.get_future(), ex);
+    for (std::size_t i = 0; i < input_cnt; ++i) {
+        detail::future_access::on_ready(state->futures[i], [state, i]() {
+            state->ready(i);
+        });
+    }
+    state->arrive();
+    return result;
+}
+
+template<typename... Rs>
+future<when_any_result<std::tuple<future<Rs>...>>> when_any(
+  future<Rs>... futures) {
+    using sequence_type = std::tuple<future<Rs>...>;
+    executor* ex = nullptr;
+    if constexpr (sizeof...(Rs) != 0) {
+        ex = std::get<0>(std::tie(futures...)).bound_executor();
+    }
+    auto state = std::make_shared<detail::when_any_state<sequence_type>>(
+      sequence_type(std::move(futures)...), sizeof...(Rs));
+    auto result = detail::bind_to(state->prom.get_future(), ex);
+    std::size_t i = 0;
+    std::apply(
+      [&state, &i](auto&... inputs) {
+          (detail::future_access::on_ready(inputs,
+                                           [state, index = i++]() {
+                                               state->ready(index);
+                                           }),
+           ...);
+      },
+      state->futures);
+    state->arrive();
+    return result;
+}
+
+}  // namespace dts
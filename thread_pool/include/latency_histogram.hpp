@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace dts {
+
+/**
+ * A log-linear histogram of durations in the spirit of HdrHistogram. Every
+ * power of two is split into sub_bucket_count buckets, so a percentile is off
+ * by less than 1 / sub_bucket_count of its value, whatever the magnitude.
+ * Durations below sub_bucket_count nanoseconds are counted exactly.
+ */
+class latency_histogram {
+public:
+    using size_type = std::size_t;
+
+    static constexpr size_type sub_bucket_count = 8;
+    // Durations are signed 64-bit, so the leading one is at most bit 62.
+    static constexpr size_type bucket_count = sub_bucket_count * (62 - 3 + 2);
+
+    void record(std::chrono::nanoseconds dur,
+                std::uint64_t cnt = 1) noexcept {
+        counts_[bucket_of(dur)] += cnt;
+        total_ += cnt;
+    }
+
+    void merge(const latency_histogram& other) noexcept {
+        for (size_type i = 0; i < bucket_count; ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+    }
+
+    std::uint64_t count() const noexcept {
+        return total_;
+    }
+
+    bool empty() const noexcept {
+        return total_ == 0;
+    }
+
+    /**
+     * The smallest duration that at least p percent of the recorded ones
+     * don't exceed, rounded up to the end of its bucket. 0 if empty.
+     */
+    std::chrono::nanoseconds percentile(double p) const noexcept {
+        if (total_ == 0) {
+            return std::chrono::nanoseconds(0);
+        }
+        auto rank = static_cast<std::uint64_t>(p / 100.0 * total_ + 0.5);
+        rank = rank == 0 ? 1 : (rank > total_ ? total_ : rank);
+        std::uint64_t seen = 0;
+        for (size_type i = 0; i < bucket_count; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                return upper_bound_of(i);
+            }
+        }
+        return upper_bound_of(bucket_count - 1);
+    }
+
+    std::chrono::nanoseconds max() const noexcept {
+        return percentile(100.0);
+    }
+
+    // The bucket dur falls into; negative durations count as 0.
+    static size_type bucket_of(std::chrono::nanoseconds dur) noexcept {
+        const auto ns = static_cast<std::uint64_t>(
+          dur.count() < 0 ? 0 : dur.count());
+        if (ns < sub_bucket_count) {
+            return static_cast<size_type>(ns);
+        }
+        size_type msb = 63;
+        while ((ns >> msb) == 0) {
+            --msb;
+        }
+        // The three bits below the leading one pick the sub-bucket.
+        const size_type shift = msb - 3;
+        return sub_bucket_count * (shift + 1) +
+               static_cast<size_type>((ns >> shift) & (sub_bucket_count - 1));
+    }
+
+    static std::chrono::nanoseconds upper_bound_of(size_type bucket) noexcept {
+        if (bucket < sub_bucket_count) {
+            return std::chrono::nanoseconds(bucket);
+        }
+        const size_type shift = bucket / sub_bucket_count - 1;
+        const std::uint64_t mantissa =
+          sub_bucket_count + bucket % sub_bucket_count;
+        constexpr auto limit = static_cast<std::uint64_t>(
+          std::numeric_limits<std::chrono::nanoseconds::rep>::max());
+        const std::uint64_t last = ((mantissa + 1) << shift) - 1;
+        return std::chrono::nanoseconds(
+          static_cast<std::chrono::nanoseconds::rep>(std::min(last, limit)));
+    }
+
+private:
+    std::array<std::uint64_t, bucket_count> counts_{};
+    std::uint64_t total_ = 0;
+};
+
+namespace detail {
+
+/**
+ * A latency_histogram with a single writer and any number of concurrent
+ * readers. Counters are relaxed atomics written without read-modify-write
+ * instructions, which is all a single writer needs.
+ */
+class recording_histogram {
+public:
+    using size_type = latency_histogram::size_type;
+
+    void record(std::chrono::nanoseconds dur) noexcept {
+        bump(counts_[latency_histogram::bucket_of(dur)]);
+    }
+
+    latency_histogram snapshot() const noexcept {
+        latency_histogram result;
+        for (size_type i = 0; i < latency_histogram::bucket_count; ++i) {
+            const std::uint64_t cnt =
+              counts_[i].load(std::memory_order_relaxed);
+            if (cnt != 0) {
+                result.record(latency_histogram::upper_bound_of(i), cnt);
+            }
+        }
+        return result;
+    }
+
+private:
+    std::array<std::atomic<std::uint64_t>, latency_histogram::bucket_count>
+      counts_{};
+
+    static void bump(std::atomic<std::uint64_t>& cnt) noexcept {
+        cnt.store(cnt.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+    }
+};
+
+}  // namespace detail
+
+}  // namespace dts
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace dts {
+
+/**
+ * A bounded lock-free multi-producer multi-consumer queue.
+ *
+ * Every cell carries a sequence number that tells producers and consumers
+ * whose turn it is, so a push or a pop is a single CAS on the enqueue or the
+ * dequeue position (Dmitry Vyukov's bounded MPMC queue). Cells and both
+ * positions sit on their own cache lines.
+ *
+ * The capacity is rounded up to a power of two.
+ */
+template<typename T>
+class mpmc_ring {
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+
+    explicit mpmc_ring(size_type capacity)
+        : mask_(round_up(capacity) - 1),
+          cells_(std::make_unique<cell[]>(mask_ + 1)),
+          enqueue_pos_(0),
+          dequeue_pos_(0) {
+        for (size_type i = 0; i <= mask_; ++i) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~mpmc_ring() {
+        while (try_pop()) {
+        }
+    }
+
+    mpmc_ring(const mpmc_ring&) = delete;
+    mpmc_ring& operator=(const mpmc_ring&) = delete;
+
+    // Leaves item untouched and returns false if the ring is full.
+    bool try_push(value_type&& item) {
+        size_type pos = enqueue_pos_.load(std::memory_order_relaxed);
+        cell* c;
+        while (true) {
+            c = &cells_[pos & mask_];
+            const size_type seq = c->seq.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::intptr_t>(seq) -
+                              static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(
+                      pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        ::new (static_cast<void*>(&c->storage)) value_type(std::move(item));
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Returns std::nullopt if the ring is empty.
+    std::optional<value_type> try_pop() {
+        size_type pos = dequeue_pos_.load(std::memory_order_relaxed);
+        cell* c;
+        while (true) {
+            c = &cells_[pos & mask_];
+            const size_type seq = c->seq.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::intptr_t>(seq) -
+                              static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(
+                      pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                return std::nullopt;
+            }
+            else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        value_type* slot =
+          std::launder(reinterpret_cast<value_type*>(&c->storage));
+        std::optional<value_type> item(std::move(*slot));
+        slot->~value_type();
+        c->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return item;
+    }
+
+    size_type capacity() const noexcept {
+        return mask_ + 1;
+    }
+
+    // Approximate when called concurrently with push or pop.
+    size_type size() const noexcept {
+        const size_type deq = dequeue_pos_.load(std::memory_order_relaxed);
+        const size_type enq = enqueue_pos_.load(std::memory_order_relaxed);
+        return enq > deq ? enq - deq : 0;
+    }
+
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+private:
+    using storage_type = std::aligned_storage_t<sizeof(T), alignof(T)>;
+
+    struct alignas(64) cell {
+        std::atomic<size_type> seq;
+        storage_type storage;
+    };
+
+    const size_type mask_;
+    const std::unique_ptr<cell[]> cells_;
+    alignas(64) std::atomic<size_type> enqueue_pos_;
+    alignas(64) std::atomic<size_type> dequeue_pos_;
+
+    static size_type round_up(size_type capacity) noexcept {
+        size_type cap = 2;
+        while (cap < capacity) {
+            cap <<= 1;
+        }
+        return cap;
+    }
+};
+
+}  // namespace dts
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "numa_topology.hpp"
+#include "thread_pool.hpp"
+
+namespace dts {
+
+/**
+ * One thread_pool per NUMA node, with the workers of each pinned to the CPUs
+ * of their node. Tasks go to the node the submitting thread is running on
+ * unless a node is named, so a task submitted by another task stays on its
+ * node and the memory it touches stays local.
+ */
+class numa_thread_pool {
+public:
+    using size_type = thread_pool::size_type;
+
+    /**
+     * Starts workers_per_node workers on every node, or one per CPU of the
+     * node if it's 0. options apply to every node's pool, except that
+     * cpu_affinity is replaced by the node's CPUs.
+     */
+    explicit numa_thread_pool(
+      size_type workers_per_node = 0,
+      const thread_pool_options& options = thread_pool_options(),
+      const std::vector<numa_node>& nodes = numa_nodes());
+
+    numa_thread_pool(const numa_thread_pool&) = delete;
+    numa_thread_pool& operator=(const numa_thread_pool&) = delete;
+
+    size_type node_count() const noexcept {
+        return nodes_.size();
+    }
+
+    const numa_node& node(size_type index) const {
+        return nodes_.at(index);
+    }
+
+    // The pool of the node at index.
+    thread_pool& pool(size_type index) {
+        return *pools_.at(index);
+    }
+
+    // Index of the node the calling thread is running on, 0 if unknown.
+    size_type local_node() const noexcept;
+
+    // thread_pool::submit() on the pool of the node at index.
+    template<typename... Args>
+    auto submit_on(size_type index, Args&&... args) {
+        return pool(index).submit(std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void post_on(size_type index, Args&&... args) {
+        pool(index).post(std::forward<Args>(args)...);
+    }
+
+    // thread_pool::submit() on the local node's pool.
+    template<typename... Args>
+    auto submit(Args&&... args) {
+        return submit_on(local_node(), std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void post(Args&&... args) {
+        post_on(local_node(), std::forward<Args>(args)...);
+    }
+
+    void wait_idle();
+
+    void shutdown(bool drain = true);
+
+private:
+    const std::vector<numa_node> nodes_;
+    std::vector<std::unique_ptr<thread_pool>> pools_;
+    // Node index by CPU, for local_node().
+    std::vector<size_type> node_of_cpu_;
+};
+
+}  // namespace dts
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace dts {
+
+struct numa_node {
+    int id;
+    // Ascending.
+    std::vector<int> cpus;
+};
+
+// Parses a Linux CPU list such as "0-3,8,10-11".
+std::vector<int> parse_cpu_list(const std::string& list);
+
+/**
+ * The NUMA nodes that have CPUs this process may run on, read from
+ * sysfs_root/node<N>/cpulist. CPUs the process may not run on are left out.
+ * Falls back to a single node 0 with every allowed CPU if sysfs_root lists no
+ * such node, e.g. on kernels without NUMA support or other platforms.
+ */
+std::vector<numa_node> numa_nodes(
+  const std::string& sysfs_root = "/sys/devices/system/node");
+
+}  // namespace dts
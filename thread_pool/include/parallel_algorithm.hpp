@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+namespace dts {
+
+namespace detail {
+
+/**
+ * Splits [0, total) into chunks that are claimed from a shared cursor by the
+ * calling thread and by up to one helper task per worker. Chunks shrink as
+ * the remaining range shrinks (guided self-scheduling) but never below grain,
+ * so early chunks are large and cheap while late ones balance the tail.
+ *
+ * The caller works through chunks itself and only waits for chunks that a
+ * running helper has already claimed. Helpers still sitting in the queue find
+ * nothing left to do, so calling this from a worker can't deadlock.
+ */
+class chunk_scheduler {
+public:
+    using size_type = std::size_t;
+
+    chunk_scheduler(size_type total, size_type grain, size_type participants)
+        : total_(total),
+          grain_(std::max<size_type>(grain, 1)),
+          participants_(participants),
+          next_(0),
+          done_(0),
+          failed_(false),
+          error_(),
+          mtx_(),
+          cv_() {}
+
+    chunk_scheduler(const chunk_scheduler&) = delete;
+    chunk_scheduler& operator=(const chunk_scheduler&) = delete;
+
+    // Calls body(begin, end) on claimed chunks until the range is exhausted.
+    template<typename Body>
+    void work(Body& body) noexcept {
+        size_type cur = next_.load(std::memory_order_relaxed);
+        while (cur < total_) {
+            const size_type remaining = total_ - cur;
+            const bool failed = failed_.load(std::memory_order_relaxed);
+            // Once failed, everything that's left is claimed without running.
+            size_type chunk = remaining;
+            if (!failed) {
+                chunk = std::max(grain_, remaining / (2 * participants_));
+                chunk = std::min(chunk, remaining);
+            }
+            if (!next_.compare_exchange_weak(cur, cur + chunk,
+                                             std::memory_order_relaxed)) {
+                continue;
+            }
+            if (!failed) {
+                try {
+                    body(cur, cur + chunk);
+                } catch (...) {
+                    if (!failed_.exchange(true)) {
+                        error_ = std::current_exception();
+                    }
+                }
+            }
+            finish(chunk);
+            cur = next_.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Waits until every chunk has run and rethrows the first exception.
+    void wait() {
+        if (done_.load(std::memory_order_acquire) != total_) {
+            std::unique_lock<std::mutex> ulock(mtx_);
+            cv_.wait(ulock, [this]() {
+                return done_.load(std::memory_order_acquire) == total_;
+            });
+        }
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+private:
+    const size_type total_;
+    const size_type grain_;
+    const size_type participants_;
+    std::atomic<size_type> next_;
+    std::atomic<size_type> done_;
+    std::atomic<bool> failed_;
+    std::exception_ptr error_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+
+    void finish(size_type chunk) noexcept {
+        if (done_.fetch_add(chunk, std::memory_order_acq_rel) + chunk ==
+            total_) {
+            std::lock_guard<std::mutex> lkgrd(mtx_);
+            cv_.notify_all();
+        }
+    }
+};
+
+/**
+ * Runs body(begin, end, participant) over [0, total) on pool and the calling
+ * thread, with participant in [0, max_participants) and unique per thread.
+ */
+template<typename Body>
+void parallel_chunks(thread_pool& pool, std::size_t total, std::size_t grain,
+                     std::size_t max_participants, Body body) {
+    if (total == 0) {
+        return;
+    }
+    grain = std::max<std::size_t>(grain, 1);
+    const std::size_t chunk_cnt = (total + grain - 1) / grain;
+    const std::size_t participants = std::min(max_participants, chunk_cnt);
+    auto scheduler =
+      std::make_shared<chunk_scheduler>(total, grain, participants);
+    for (std::size_t id = 1; id < participants; ++id) {
+        auto helper = [scheduler, &body, id]() {
+            auto run = [&body, id](std::size_t begin, std::size_t end) {
+                body(begin, end, id);
+            };
+            scheduler->work(run);
+        };
+        try {
+            pool.post(std::move(helper));
+        } catch (thread_pool_stopped&) {
+            // Whatever isn't picked up by a helper is run by this thread.
+            break;
+        }
+    }
+    auto run = [&body](std::size_t begin, std::size_t end) {
+        body(begin, end, 0);
+    };
+    scheduler->work(run);
+    scheduler->wait();
+}
+
+// Integers index themselves, iterators are dereferenced.
+template<typename It>
+decltype(auto) element_at(It first, std::size_t offset) {
+    if constexpr (std::is_integral_v<It>) {
+        return static_cast<It>(first + offset);
+    }
+    else {
+        return *(first + offset);
+    }
+}
+
+template<typename It>
+std::size_t distance(It first, It last) {
+    if constexpr (std::is_integral_v<It>) {
+        return first < last ? static_cast<std::size_t>(last - first) : 0;
+    }
+    else {
+        using category = typename std::iterator_traits<It>::iterator_category;
+        static_assert(
+          std::is_base_of_v<std::random_access_iterator_tag, category>,
+          "It must be an integer or a random access iterator");
+        return first < last ? static_cast<std::size_t>(last - first) : 0;
+    }
+}
+
+template<typename T>
+struct alignas(64) padded_partial {
+    std::optional<T> value;
+};
+
+}  // namespace detail
+
+/**
+ * Calls fn(i) for every i in [first, last) if It is an integer, or fn(*it) for
+ * every it in [first, last) if It is a random access iterator. Runs on the
+ * pool's workers and the calling thread, in chunks of at least grain items.
+ *
+ * Rethrows the first exception thrown by fn once all started chunks have
+ * finished. Chunks not yet started by then are skipped.
+ */
+template<typename It, typename Fn>
+void parallel_for(thread_pool& pool, It first, It last, std::size_t grain,
+                  Fn&& fn) {
+    detail::parallel_chunks(
+      pool, detail::distance(first, last), grain, pool.worker_count() + 1,
+      [first, &fn](std::size_t begin, std::size_t end, std::size_t) {
+          for (std::size_t i = begin; i != end; ++i) {
+              fn(detail::element_at(first, i));
+          }
+      });
+}
+
+template<typename It, typename Fn>
+void parallel_for(thread_pool& pool, It first, It last, Fn&& fn) {
+    parallel_for(pool, first, last, 1, std::forward<Fn>(fn));
+}
+
+/**
+ * Like std::transform_reduce(first, last, init, reduce, transform) but on the
+ * pool. Elements are as in parallel_for(). reduce must be associative and
+ * commutative since partial results are combined in no particular order.
+ */
+template<typename It, typename T, typename Reduce, typename Transform>
+T parallel_reduce(thread_pool& pool, It first, It last, std::size_t grain,
+                  T init, Reduce reduce, Transform transform) {
+    const std::size_t participants = pool.worker_count() + 1;
+    std::vector<detail::padded_partial<T>> partials(participants);
+    detail::parallel_chunks(
+      pool, detail::distance(first, last), grain, participants,
+      [&](std::size_t begin, std::size_t end, std::size_t id) {
+          std::optional<T>& partial = partials[id].value;
+          std::size_t i = begin;
+          if (!partial) {
+              partial.emplace(transform(detail::element_at(first, i++)));
+          }
+          for (; i != end; ++i) {
+              *partial = reduce(std::move(*partial),
+                                transform(detail::element_at(first, i)));
+          }
+      });
+    for (auto& partial : partials) {
+        if (partial.value) {
+            init = reduce(std::move(init), std::move(*partial.value));
+        }
+    }
+    return init;
+}
+
+template<typename It, typename T, typename Reduce>
+T parallel_reduce(thread_pool& pool, It first, It last, std::size_t grain,
+                  T init, Reduce reduce) {
+    return parallel_reduce(pool, first, last, grain, std::move(init),
+                           std::move(reduce), [](const auto& elem) -> T {
+                               return elem;
+                           });
+}
+
+/**
+ * Like std::transform(first, last, d_first, op) but on the pool. Both It and
+ * OutIt must be random access iterators. Returns the end of the output range.
+ */
+template<typename It, typename OutIt, typename Op>
+OutIt parallel_transform(thread_pool& pool, It first, It last, OutIt d_first,
+                         std::size_t grain, Op&& op) {
+    const std::size_t total = detail::distance(first, last);
+    detail::parallel_chunks(
+      pool, total, grain, pool.worker_count() + 1,
+      [first, d_first, &op](std::size_t begin, std::size_t end, std::size_t) {
+          for (std::size_t i = begin; i != end; ++i) {
+              d_first[i] = op(first[i]);
+          }
+      });
+    return d_first + total;
+}
+
+}  // namespace dts
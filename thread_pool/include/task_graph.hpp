@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "future.hpp"
+#include "thread_pool.hpp"
+#include "unique_task.hpp"
+
+namespace dts {
+
+/**
+ * A directed acyclic graph of tasks. A node is posted to the pool once every
+ * node it depends on has run, so no worker ever waits for another task. Of
+ * the successors a node makes runnable, one runs right away on the same
+ * worker and the others are posted.
+ *
+ * A graph can be run again once the previous run has finished. It must not be
+ * modified or destroyed while it runs.
+ */
+class task_graph {
+public:
+    using size_type = std::size_t;
+    using node_id = std::size_t;
+
+    task_graph() = default;
+
+    task_graph(const task_graph&) = delete;
+    task_graph& operator=(const task_graph&) = delete;
+
+    // Adds a node running fn(), which may be called once per run.
+    template<typename Fn>
+    node_id emplace(Fn&& fn) {
+        nodes_.push_back(node{ unique_task(std::forward<Fn>(fn)), {}, 0 });
+        return nodes_.size() - 1;
+    }
+
+    /**
+     * Makes after depend on before. Throws std::out_of_range if either isn't
+     * a node of this graph.
+     */
+    void precede(node_id before, node_id after);
+
+    size_type size() const noexcept {
+        return nodes_.size();
+    }
+
+    /**
+     * Posts every node without dependencies to pool and returns a future that
+     * becomes ready, bound to pool, once all nodes have run. It holds the
+     * first exception thrown by a node; nodes that haven't started by then are
+     * skipped. If the pool stops meanwhile, the remaining nodes are skipped
+     * and the future gets thread_pool_stopped.
+     *
+     * Throws std::invalid_argument if the graph has a cycle.
+     */
+    future<void> run(thread_pool& pool);
+
+private:
+    struct node {
+        unique_task fn;
+        std::vector<node_id> successors;
+        size_type dependency_cnt;
+    };
+
+    class run_state;
+
+    std::vector<node> nodes_;
+
+    bool has_cycle() const;
+};
+
+}  // namespace dts
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+namespace dts {
+
+// Each level is a separate FIFO lane of the shared queue.
+enum class task_priority {
+    high,
+    normal,
+    low,
+};
+
+inline constexpr std::size_t task_priority_count = 3;
+
+}  // namespace dts
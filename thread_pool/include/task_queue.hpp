@@ -1,48 +1,89 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <condition_variable>
-#include <future>
 #include <mutex>
-#include <queue>
+#include <optional>
+#include <vector>
 
+#include "basic_task_queue.hpp"
 #include "thread_pool_stopped.hpp"
 
 namespace dts {
 
-class task_queue {
+// An unbounded queue protected by a mutex.
+class task_queue final : public basic_task_queue {
 public:
-    using task_type = std::packaged_task<void()>;
-    using value_type = task_type;
-    using size_type = std::queue<task_type>::size_type;
-
-    task_queue() = default;
-    ~task_queue() = default;
-
-    task_queue(const task_queue&) = delete;
-    task_queue& operator=(const task_queue&) = delete;
+    explicit task_queue(size_type starvation_limit = 16);
+    ~task_queue() override = default;
 
     template<typename... Args>
     void emplace(Args&&... args) {
-        {
-            std::unique_lock<std::mutex> ulock(mtx_);
-            if (!accept_push_) {
-                throw thread_pool_stopped(
-                  "task_queue::push() called after stopping push.");
-            }
-            q_.emplace(std::forward<Args>(args)...);
-        }
-        cv_.notify_one();
+        push(task_type(std::forward<Args>(args)...));
     }
 
-    task_type poll();
+    using basic_task_queue::push;
+    using basic_task_queue::push_bulk;
+
+    void push(task_type&& task, task_priority priority) override;
+
+    /**
+     * Moves every task out of tasks under a single lock acquisition and wakes
+     * at most as many waiting pollers as there are tasks.
+     */
+    void push_bulk(std::vector<task_type>& tasks,
+                   task_priority priority) override;
+
+    task_type poll() override;
+
+    std::optional<task_type> poll_for(
+      std::chrono::nanoseconds timeout) override;
+
+    std::optional<task_type> try_poll() override;
 
-    void stop_push();
+    // Doesn't lock, so it's cheap enough to spin on.
+    bool empty() override;
+
+    bool empty(task_priority priority) override;
+
+    void stop_push() override;
+
+    void retire_pollers(size_type cnt) override;
 
 private:
+    /**
+     * A growable ring buffer instead of std::queue, whose deque allocates and
+     * frees a block every few elements. Slots are reused once it has grown.
+     */
+    struct lane {
+        std::vector<task_type> ring;
+        size_type head = 0;
+        // Only written under mtx_, but read without it by empty(priority).
+        std::atomic<size_type> size{ 0 };
+        // Polls served from other lanes while this one was waiting.
+        size_type skipped = 0;
+    };
+
+    const size_type starvation_limit_;
     std::mutex mtx_;
     std::condition_variable cv_;
     bool accept_push_ = true;
-    std::queue<task_type> q_;
+    // Number of pollers blocked on cv_.
+    size_type waiting_cnt_ = 0;
+    // Pending retire_pollers() requests.
+    size_type retire_cnt_ = 0;
+    std::array<lane, task_priority_count> lanes_;
+    // Total over all lanes. Only written under mtx_, but read without it by
+    // empty().
+    std::atomic<size_type> size_{ 0 };
+
+    void push_back(task_type&& task, task_priority priority);
+    task_type pop_front();
+
+    bool poll_ready() const noexcept;
+    // Must be called under mtx_ once poll_ready() is true.
+    task_type take_polled();
 };
 
 }  // namespace dts
@@ -1,37 +1,434 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
 
-#include "task_queue.hpp"
+#include "basic_task_queue.hpp"
+#include "event_count.hpp"
+#include "executor.hpp"
+#include "future.hpp"
+#include "task_priority.hpp"
+#include "thread_pool_options.hpp"
+#include "thread_pool_overloaded.hpp"
+#include "thread_pool_stats.hpp"
+#include "thread_pool_stopped.hpp"
+#include "work_stealing_deque.hpp"
 
 namespace dts {
 
-class thread_pool {
+namespace detail {
+
+// Shared by all tasks of a thread_pool::post_bulk() batch.
+template<typename Fn>
+class bulk_completion {
 public:
-    using task_type = typename task_queue::task_type;
-    using size_type = typename task_queue::size_type;
+    explicit bulk_completion(Fn&& fn)
+        : fn_(std::move(fn)),
+          remaining_(0),
+          failed_(false),
+          error_(),
+          prom_() {}
+
+    ~bulk_completion() {
+        // Some tasks were dropped by thread_pool::shutdown_now().
+        if (remaining_.load(std::memory_order_relaxed) != 0) {
+            prom_.set_exception(std::make_exception_ptr(thread_pool_stopped(
+              "Tasks of the batch were dropped by a stopping thread_pool.")));
+        }
+    }
+
+    future<void> get_future() {
+        return prom_.get_future();
+    }
+
+    // Must be called before any task of the batch runs.
+    void arm(std::size_t task_cnt) {
+        remaining_.store(task_cnt, std::memory_order_relaxed);
+        if (task_cnt == 0) {
+            prom_.set_value();
+        }
+    }
 
-    thread_pool(size_type worker_cnt);
-    ~thread_pool();
+    template<typename Item>
+    void run(Item& item) {
+        try {
+            std::invoke(fn_, item);
+        } catch (...) {
+            if (!failed_.exchange(true, std::memory_order_relaxed)) {
+                error_ = std::current_exception();
+            }
+        }
+        if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            if (error_) {
+                prom_.set_exception(error_);
+            }
+            else {
+                prom_.set_value();
+            }
+        }
+    }
+
+private:
+    Fn fn_;
+    std::atomic<std::size_t> remaining_;
+    std::atomic<bool> failed_;
+    // Only the first exception is kept.
+    std::exception_ptr error_;
+    promise<void> prom_;
+};
+
+template<typename InputIt>
+void reserve_for(std::vector<unique_task>& tasks, InputIt first,
+                 InputIt last) {
+    using category = typename std::iterator_traits<InputIt>::iterator_category;
+    if constexpr (std::is_base_of_v<std::forward_iterator_tag, category>) {
+        tasks.reserve(std::distance(first, last));
+    }
+}
+
+#if DTS_THREAD_POOL_STATS
+/**
+ * A worker's counters. Only the worker writes them, so they are relaxed
+ * atomics for the sake of stats() and updated without read-modify-write
+ * instructions.
+ */
+struct alignas(64) worker_counters {
+    std::atomic<std::uint64_t> tasks_executed{ 0 };
+    std::atomic<std::uint64_t> tasks_stolen{ 0 };
+    std::atomic<std::int64_t> busy_ns{ 0 };
+    std::atomic<std::int64_t> idle_ns{ 0 };
+    std::atomic<bool> running{ false };
+    recording_histogram queue_wait;
+    recording_histogram run_time;
+
+    template<typename T>
+    static void add(std::atomic<T>& counter, T value) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + value,
+                      std::memory_order_relaxed);
+    }
+
+    worker_stats snapshot() const noexcept;
+};
+#endif
+
+}  // namespace detail
+
+class thread_pool : public executor {
+public:
+    using task_type = typename basic_task_queue::task_type;
+    using size_type = typename basic_task_queue::size_type;
+
+    thread_pool(size_type worker_cnt,
+                const thread_pool_options& options = thread_pool_options());
+    ~thread_pool() override;
 
     thread_pool(const thread_pool&) = delete;
     thread_pool& operator=(const thread_pool&) = delete;
 
+    // The number of workers the pool is heading for; see resize().
+    size_type worker_count() const noexcept {
+        return worker_cnt_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Starts or retires workers so that worker_cnt are left. Surplus workers
+     * finish their current task and exit when they next wait for work.
+     * Elastic pools clamp worker_cnt to [min_workers, max_workers] and keep
+     * adjusting from there.
+     *
+     * Throws std::invalid_argument in work-stealing mode if worker_cnt exceeds
+     * both the initial worker count and thread_pool_options::max_workers, and
+     * thread_pool_stopped once the pool has been shut down.
+     */
+    void resize(size_type worker_cnt);
+
+    /**
+     * Runs fn(args...) on a worker. Like std::bind, fn and args are decay
+     * copied and args are passed as lvalues.
+     *
+     * Doesn't allocate if the callable together with a promise fits in
+     * task_type's inline storage and the promise pool has warmed up. The
+     * future is bound to this pool, so its continuations run here.
+     */
+    template<typename Fn, typename... Args>
+    future<detail::bound_result_t<Fn, Args...>> submit(Fn&& fn,
+                                                       Args&&... args) {
+        return submit(task_priority::normal, std::forward<Fn>(fn),
+                      std::forward<Args>(args)...);
+    }
+
+    /**
+     * Like submit(fn, args...) but queues the task in the lane of priority.
+     * Workers take the highest-priority task first; see
+     * thread_pool_options::starvation_limit.
+     */
+    template<typename Fn, typename... Args>
+    future<detail::bound_result_t<Fn, Args...>> submit(task_priority priority,
+                                                       Fn&& fn,
+                                                       Args&&... args) {
+        using fn_res_t = detail::bound_result_t<Fn, Args...>;
+        detail::task_promise<fn_res_t> prom;
+        auto future = prom.get_future();
+        task_type task(
+          [prom = std::move(prom), fn = std::forward<Fn>(fn),
+           args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+              prom.fulfill([&]() -> fn_res_t {
+                  return std::apply(fn, args);
+              });
+          });
+        schedule(std::move(task), priority);
+        return std::move(future).via(*this);
+    }
+
+    /**
+     * Runs fn(args...) on a worker without any result channel, so nothing but
+     * the task itself is enqueued. Exceptions are handled according to
+     * thread_pool_options::exception_handler.
+     */
+    template<typename Fn, typename... Args>
+    void post(Fn&& fn, Args&&... args) {
+        post(task_priority::normal, std::forward<Fn>(fn),
+             std::forward<Args>(args)...);
+    }
+
+    // Like post(fn, args...) but queues the task in the lane of priority.
     template<typename Fn, typename... Args>
-    decltype(auto) submit(Fn&& fn, Args&&... args) {
-        using fn_res_t = std::invoke_result_t<Fn, Args...>;
-        std::packaged_task<fn_res_t()> ptask(
-          std::bind(std::forward<Fn>(fn), std::forward<Args>(args)...));
-        auto future = ptask.get_future();
-        tq_.emplace(std::move(ptask));
-        return future;
+    void post(task_priority priority, Fn&& fn, Args&&... args) {
+        if constexpr (sizeof...(Args) == 0) {
+            schedule(task_type(std::forward<Fn>(fn)), priority);
+        }
+        else {
+            task_type task(
+              [fn = std::forward<Fn>(fn),
+               args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+                  std::apply(fn, args);
+              });
+            schedule(std::move(task), priority);
+        }
+    }
+
+    // Awaitable returned by schedule().
+    class schedule_awaiter {
+    public:
+        schedule_awaiter(thread_pool& pool, task_priority priority) noexcept
+            : pool_(pool), priority_(priority) {}
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        // A template so that this header doesn't need C++20.
+        template<typename Handle>
+        void await_suspend(Handle handle) {
+            pool_.post(priority_, [handle]() mutable {
+                handle.resume();
+            });
+        }
+
+        void await_resume() const noexcept {}
+
+    private:
+        thread_pool& pool_;
+        task_priority priority_;
+    };
+
+    /**
+     * co_await pool.schedule() resumes the coroutine on a worker. It costs a
+     * single queued task, which holds nothing but the coroutine handle, and
+     * throws thread_pool_stopped if the pool doesn't accept tasks anymore. A
+     * coroutine whose task is dropped by shutdown_now() is never resumed. See
+     * coroutine.hpp for task and sync_wait().
+     */
+    schedule_awaiter schedule(
+      task_priority priority = task_priority::normal) noexcept {
+        return schedule_awaiter(*this, priority);
+    }
+
+    // Like post(task), for futures bound to this pool.
+    void dispatch(unique_task&& task) override;
+
+    /**
+     * Submits fn(item) for every item in [first, last) and returns their
+     * futures in order. All tasks are enqueued at once, under one lock
+     * acquisition, waking no more workers than there are tasks. Items are
+     * copied into the tasks and fn is shared by all of them.
+     */
+    template<typename InputIt, typename Fn>
+    std::vector<future<std::invoke_result_t<
+      std::decay_t<Fn>&, typename std::iterator_traits<InputIt>::value_type&>>>
+    submit_bulk(InputIt first, InputIt last, Fn&& fn) {
+        using item_type = typename std::iterator_traits<InputIt>::value_type;
+        using fn_res_t = std::invoke_result_t<std::decay_t<Fn>&, item_type&>;
+        auto shared_fn =
+          std::make_shared<std::decay_t<Fn>>(std::forward<Fn>(fn));
+        std::vector<task_type> tasks;
+        detail::reserve_for(tasks, first, last);
+        std::vector<future<fn_res_t>> futures;
+        futures.reserve(tasks.capacity());
+        for (; first != last; ++first) {
+            detail::task_promise<fn_res_t> prom;
+            futures.emplace_back(prom.get_future().via(*this));
+            tasks.emplace_back([prom = std::move(prom), shared_fn,
+                                item = item_type(*first)]() mutable {
+                prom.fulfill([&]() -> fn_res_t {
+                    return std::invoke(*shared_fn, item);
+                });
+            });
+        }
+        schedule_bulk(tasks);
+        return futures;
     }
 
+    /**
+     * Like submit_bulk() but without a future per item. The returned future
+     * becomes ready once every task has run and holds the first exception
+     * thrown by any of them.
+     */
+    template<typename InputIt, typename Fn>
+    future<void> post_bulk(InputIt first, InputIt last, Fn&& fn) {
+        using item_type = typename std::iterator_traits<InputIt>::value_type;
+        using batch_type = detail::bulk_completion<std::decay_t<Fn>>;
+        auto batch = std::make_shared<batch_type>(std::forward<Fn>(fn));
+        auto future = batch->get_future();
+        std::vector<task_type> tasks;
+        detail::reserve_for(tasks, first, last);
+        for (; first != last; ++first) {
+            tasks.emplace_back([batch, item = item_type(*first)]() mutable {
+                batch->run(item);
+            });
+        }
+        batch->arm(tasks.size());
+        schedule_bulk(tasks);
+        return std::move(future).via(*this);
+    }
+
+    /**
+     * Stops accepting tasks and joins the workers. With drain, they run
+     * everything that's already queued first, which is what the destructor
+     * does. Without drain this is shutdown_now().
+     *
+     * Calls after the first one return right away. Must not be called from
+     * one of the pool's tasks.
+     */
+    void shutdown(bool drain = true);
+
+    /**
+     * Stops accepting tasks, lets running tasks finish and drops everything
+     * still queued. Futures of dropped tasks get thread_pool_stopped. Returns
+     * the number of dropped tasks.
+     */
+    size_type shutdown_now();
+
+    /**
+     * Blocks until every task submitted so far, and every task those submit,
+     * has run. Tasks may be submitted meanwhile. Must not be called from one
+     * of the pool's tasks.
+     */
+    void wait_idle();
+
+    /**
+     * Counters of every worker, and of the pool as a whole. Without
+     * DTS_THREAD_POOL_STATS only pending_tasks and pin_failures are filled.
+     */
+    thread_pool_stats stats() const;
+
 private:
-    task_queue tq_;
-    std::vector<std::thread> workers_;
+    using local_queue_type = work_stealing_deque<task_type*>;
+
+    struct worker {
+        std::thread thread;
+        // Index of its deque in work-stealing mode.
+        size_type slot = 0;
+        // Set with thread_pool_options::pin_one_cpu_per_worker.
+        int cpu = -1;
+        // Set under workers_mtx_ right before the thread exits.
+        bool exited = false;
+        size_type id = 0;
+#if DTS_THREAD_POOL_STATS
+        // When the worker last finished a task, or started.
+        std::chrono::steady_clock::time_point idle_since;
+        detail::worker_counters counters;
+#endif
+    };
+
+    const thread_pool_options options_;
+    const std::unique_ptr<basic_task_queue> tq_;
+
+    // Only used in work-stealing mode. One deque per worker slot.
+    std::vector<std::unique_ptr<local_queue_type>> local_queues_;
+    std::atomic<bool> stopping_;
+    event_count idle_workers_;
+    // Workers asked to exit in work-stealing mode. The shared queue's
+    // retire_pollers() does the same otherwise.
+    std::atomic<size_type> retire_cnt_;
+
+    // Tasks scheduled but not yet finished or dropped.
+    std::atomic<size_type> pending_;
+    event_count idle_waiters_;
+    // Set by shutdown_now(). Workers drop the tasks they find instead.
+    std::atomic<bool> discarding_;
+    std::atomic<size_type> dropped_;
+    std::mutex shutdown_mtx_;
+
+    // Workers not asked to retire.
+    std::atomic<size_type> worker_cnt_;
+    mutable std::mutex workers_mtx_;
+    std::condition_variable worker_exited_cv_;
+    // The rest is guarded by workers_mtx_.
+    bool accept_workers_;
+    std::vector<std::unique_ptr<worker>> workers_;
+    // Deque slots not owned by any worker.
+    std::vector<size_type> free_slots_;
+    // Index into thread_pool_options::cpu_affinity for the next worker.
+    size_type next_cpu_;
+    // Workers that couldn't apply thread_pool_options::cpu_affinity.
+    std::atomic<size_type> pin_failures_;
+#if DTS_THREAD_POOL_STATS
+    // Counters of the workers that have exited.
+    worker_stats retired_stats_;
+#endif
+    size_type next_worker_id_;
+
+    void schedule(task_type&& task, task_priority priority);
+    void schedule_bulk(std::vector<task_type>& tasks);
+    void enqueue(task_type&& task, task_priority priority);
+    void enqueue_bulk(std::vector<task_type>& tasks);
+    void push_shared(task_type& task, task_priority priority);
+    bool worker_must_not_block() const noexcept;
+    bool runs_overflow_in_caller() const noexcept;
+    void run_in_caller(task_type& task);
+    void execute(task_type& task) noexcept;
+    void execute_on_worker(worker& self, task_type& task) noexcept;
+    void run_or_drop(task_type& task) noexcept;
+    void run_task(task_type& task) noexcept;
+    void finish_tasks(size_type task_cnt) noexcept;
+    void stop_and_join();
+
+    bool spawn_worker(std::unique_lock<std::mutex>& ulock, bool wait_for_slot);
+    void reap_workers();
+    void retire_workers(size_type cnt);
+    bool retire_idle_worker() noexcept;
+    void grow_if_needed();
+    void worker_main(worker& self);
+
+    void worker_func(worker& self);
 
-    void worker_func();
+    void stealing_worker_func(worker& self);
+    std::optional<task_type> find_task(size_type index, size_type& victim);
+    bool has_pending_task();
+    bool claim_retirement() noexcept;
+    // Returns false if it timed out.
+    bool park_worker();
+    void wake_workers(size_type task_cnt);
 };
 
 }  // namespace dts
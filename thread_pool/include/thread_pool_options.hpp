@@ -0,0 +1,122 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <vector>
+
+namespace dts {
+
+// What a producer does when a bounded queue is full.
+enum class overflow_policy {
+    // Wait on a condition variable until a slot frees up.
+    block,
+    // Busy-wait, yielding the CPU, until a slot frees up.
+    spin,
+    // Throw thread_pool_overloaded.
+    reject,
+    // Run the task right away on the submitting thread.
+    run_in_caller,
+};
+
+struct thread_pool_options {
+    /**
+     * Give each worker a local work-stealing deque. Tasks submitted from a
+     * worker go to its own deque, tasks submitted from any other thread go to
+     * the shared task_queue, and idle workers steal from their peers.
+     */
+    bool work_stealing = false;
+
+    /**
+     * 0 keeps the unbounded, mutex-protected task_queue as the shared queue.
+     * Otherwise the shared queue is a lock-free bounded_task_queue whose
+     * priority lanes hold at most this many tasks each, rounded up to a power
+     * of two, and overflow decides what happens when a lane is full. The
+     * queue as a whole holds up to task_priority_count times as many.
+     * Work-stealing deques stay unbounded.
+     *
+     * Workers make room in the queue, so a worker never waits for room
+     * itself: under block and spin, a task it submits to a full queue runs
+     * right away on the worker instead.
+     */
+    std::size_t queue_capacity = 0;
+    overflow_policy overflow = overflow_policy::block;
+
+    /**
+     * A task waits for at most this many tasks to be taken from higher
+     * priority lanes of the shared queue before it's taken ahead of them. 1
+     * turns priorities into a round robin over the non-empty lanes, and so
+     * does 0.
+     */
+    std::size_t starvation_limit = 16;
+
+    /**
+     * How an idle worker waits for work. It checks the queues spin_count times
+     * with a CPU pause in between, then yield_count times with
+     * std::this_thread::yield() in between, and only then parks on a
+     * condition variable. Spinning cuts the wake-up latency of the next burst
+     * at the cost of CPU time. The defaults park right away.
+     *
+     * With adaptive_spin each worker tunes its own budget up to spin_count,
+     * doubling it whenever spinning or yielding found work and halving it,
+     * down to spin_count / 16 but at least 1, whenever the worker had to park.
+     */
+    std::size_t spin_count = 0;
+    std::size_t yield_count = 0;
+    bool adaptive_spin = false;
+
+    /**
+     * A non-zero max_workers makes the pool elastic. It then starts with the
+     * requested number of workers clamped to [min_workers, max_workers], adds
+     * a worker whenever a submission finds more than grow_threshold tasks
+     * waiting for a worker, and retires workers that have been idle for
+     * idle_timeout, down to min_workers.
+     *
+     * In work-stealing mode max_workers also bounds thread_pool::resize(),
+     * since every worker needs a deque of its own.
+     */
+    std::size_t min_workers = 0;
+    std::size_t max_workers = 0;
+    std::size_t grow_threshold = 0;
+    std::chrono::milliseconds idle_timeout{ 10000 };
+
+    /**
+     * CPUs the workers may run on. Empty leaves them to the OS scheduler. With
+     * pin_one_cpu_per_worker every worker is bound to a single CPU of the
+     * list, handed out round robin, instead of to the whole list. The
+     * constructor throws std::invalid_argument if the process may not run on
+     * one of them. A worker that fails to pin itself anyway, e.g. because a
+     * CPU went offline or the platform has no affinity API, runs unpinned and
+     * is counted in thread_pool_stats::pin_failures.
+     */
+    std::vector<int> cpu_affinity;
+    bool pin_one_cpu_per_worker = false;
+
+    /**
+     * Record how long every task waited in the queue and how long it ran into
+     * the histograms of thread_pool::stats(). Stamping a task with its
+     * submission time wraps it, which takes a heap allocation per task.
+     */
+    bool latency_histograms = false;
+
+    /**
+     * Called on the worker right before and right after each task, with the
+     * worker's id from thread_pool::stats(), e.g. to export metrics. They
+     * must not throw. Without DTS_THREAD_POOL_STATS they are never called.
+     */
+    std::function<void(std::size_t worker_id)> on_task_start;
+    std::function<void(std::size_t worker_id,
+                       std::chrono::nanoseconds run_time)>
+      on_task_end;
+
+    /**
+     * Called on the worker with any exception that escapes a task given to
+     * thread_pool::post(). std::terminate() is called if it's empty or if it
+     * throws itself. Exceptions from thread_pool::submit() tasks always go to
+     * their futures instead.
+     */
+    std::function<void(std::exception_ptr)> exception_handler;
+};
+
+}  // namespace dts
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdexcept>
+
+namespace dts {
+
+class thread_pool_overloaded final : public std::runtime_error {
+public:
+    thread_pool_overloaded(const std::string& msg) : std::runtime_error(msg) {}
+
+    thread_pool_overloaded(const char* msg) : std::runtime_error(msg) {}
+
+    ~thread_pool_overloaded() override = default;
+
+    thread_pool_overloaded(const thread_pool_overloaded&) = default;
+    thread_pool_overloaded& operator=(const thread_pool_overloaded&) = default;
+};
+
+}  // namespace dts
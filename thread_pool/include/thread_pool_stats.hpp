@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "latency_histogram.hpp"
+
+/**
+ * Define DTS_THREAD_POOL_STATS as 0 to compile the counters, timing and hooks
+ * out of thread_pool. It must have the same value in every translation unit,
+ * which the CMake option of the same name takes care of.
+ */
+#ifndef DTS_THREAD_POOL_STATS
+#define DTS_THREAD_POOL_STATS 1
+#endif
+
+namespace dts {
+
+// What a worker has done so far.
+struct worker_stats {
+    // Unique within the pool, and what the task hooks are called with.
+    std::size_t id = 0;
+    std::uint64_t tasks_executed = 0;
+    // Tasks taken from other workers' deques in work-stealing mode.
+    std::uint64_t tasks_stolen = 0;
+    std::chrono::nanoseconds busy_time{ 0 };
+    // Time between tasks, spent looking for work, spinning or parked.
+    std::chrono::nanoseconds idle_time{ 0 };
+    // Only filled with thread_pool_options::latency_histograms.
+    latency_histogram queue_wait;
+    latency_histogram run_time;
+
+    // Adds other's counts to these, keeping id.
+    void merge(const worker_stats& other) noexcept {
+        tasks_executed += other.tasks_executed;
+        tasks_stolen += other.tasks_stolen;
+        busy_time += other.busy_time;
+        idle_time += other.idle_time;
+        queue_wait.merge(other.queue_wait);
+        run_time.merge(other.run_time);
+    }
+};
+
+/**
+ * A snapshot of a thread_pool. Counters of different workers are read one
+ * after the other while they keep running, so they needn't add up exactly.
+ * Only tasks run by workers are counted, not those run by a submitting
+ * thread under overflow_policy::run_in_caller.
+ */
+struct thread_pool_stats {
+    // Tasks submitted but not yet finished, including running ones.
+    std::size_t pending_tasks = 0;
+    std::size_t running_tasks = 0;
+    // Workers, including exited ones, that couldn't pin themselves to
+    // thread_pool_options::cpu_affinity and ran unpinned instead.
+    std::size_t pin_failures = 0;
+    std::vector<worker_stats> workers;
+    // The sum over workers that have exited.
+    worker_stats retired;
+
+    // Tasks waiting for a worker.
+    std::size_t queued_tasks() const noexcept {
+        return pending_tasks > running_tasks ? pending_tasks - running_tasks :
+                                               0;
+    }
+
+    // The sum over current and retired workers.
+    worker_stats total() const noexcept {
+        worker_stats sum = retired;
+        for (const worker_stats& w : workers) {
+            sum.merge(w);
+        }
+        return sum;
+    }
+};
+
+}  // namespace dts
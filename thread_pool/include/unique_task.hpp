@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace dts {
+
+/**
+ * A move-only, type-erased void() callable.
+ *
+ * Callables up to inline_size bytes that are nothrow move constructible are
+ * stored in place, so wrapping a typical lambda doesn't touch the heap. Larger
+ * callables fall back to a heap allocation.
+ */
+class unique_task {
+public:
+    static constexpr std::size_t inline_size = 6 * sizeof(void*);
+    static constexpr std::size_t inline_align = alignof(std::max_align_t);
+
+    template<typename Fn>
+    static constexpr bool is_stored_inline =
+      sizeof(Fn) <= inline_size && alignof(Fn) <= inline_align &&
+      std::is_nothrow_move_constructible_v<Fn>;
+
+    unique_task() noexcept : vtable_(nullptr) {}
+
+    template<typename Fn,
+             typename = std::enable_if_t<
+               !std::is_same_v<std::decay_t<Fn>, unique_task>>>
+    unique_task(Fn&& fn) : vtable_(&vtable_for<std::decay_t<Fn>>) {
+        using fn_type = std::decay_t<Fn>;
+        static_assert(std::is_invocable_v<fn_type&>,
+                      "Fn must be invocable without any argument");
+        if constexpr (is_stored_inline<fn_type>) {
+            ::new (static_cast<void*>(&storage_))
+              fn_type(std::forward<Fn>(fn));
+        }
+        else {
+            ::new (static_cast<void*>(&storage_))
+              fn_type*(new fn_type(std::forward<Fn>(fn)));
+        }
+    }
+
+    ~unique_task() {
+        reset();
+    }
+
+    unique_task(unique_task&& other) noexcept : vtable_(other.vtable_) {
+        if (vtable_ != nullptr) {
+            vtable_->move(&storage_, &other.storage_);
+            other.vtable_ = nullptr;
+        }
+    }
+
+    unique_task& operator=(unique_task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            vtable_ = other.vtable_;
+            if (vtable_ != nullptr) {
+                vtable_->move(&storage_, &other.storage_);
+                other.vtable_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    unique_task(const unique_task&) = delete;
+    unique_task& operator=(const unique_task&) = delete;
+
+    explicit operator bool() const noexcept {
+        return vtable_ != nullptr;
+    }
+
+    void operator()() {
+        if (vtable_ == nullptr) {
+            throw std::bad_function_call();
+        }
+        vtable_->invoke(&storage_);
+    }
+
+    /**
+     * The stored callable if it's an Fn, like std::function::target(),
+     * otherwise nullptr.
+     */
+    template<typename Fn>
+    Fn* target() noexcept {
+        if (vtable_ != &vtable_for<Fn>) {
+            return nullptr;
+        }
+        return &stored<Fn>(&storage_);
+    }
+
+    void reset() noexcept {
+        if (vtable_ != nullptr) {
+            vtable_->destroy(&storage_);
+            vtable_ = nullptr;
+        }
+    }
+
+private:
+    using storage_type = std::aligned_storage_t<inline_size, inline_align>;
+
+    struct vtable {
+        void (*invoke)(storage_type*);
+        // Move-constructs dst from src and destroys src.
+        void (*move)(storage_type* dst, storage_type* src) noexcept;
+        void (*destroy)(storage_type*) noexcept;
+    };
+
+    template<typename Fn>
+    static Fn& stored(storage_type* s) noexcept {
+        if constexpr (is_stored_inline<Fn>) {
+            return *std::launder(reinterpret_cast<Fn*>(s));
+        }
+        else {
+            return **std::launder(reinterpret_cast<Fn**>(s));
+        }
+    }
+
+    template<typename Fn>
+    static void invoke_fn(storage_type* s) {
+        std::invoke(stored<Fn>(s));
+    }
+
+    template<typename Fn>
+    static void move_fn(storage_type* dst, storage_type* src) noexcept {
+        if constexpr (is_stored_inline<Fn>) {
+            Fn& fn = stored<Fn>(src);
+            ::new (static_cast<void*>(dst)) Fn(std::move(fn));
+            fn.~Fn();
+        }
+        else {
+            ::new (static_cast<void*>(dst))
+              Fn*(*std::launder(reinterpret_cast<Fn**>(src)));
+        }
+    }
+
+    template<typename Fn>
+    static void destroy_fn(storage_type* s) noexcept {
+        if constexpr (is_stored_inline<Fn>) {
+            stored<Fn>(s).~Fn();
+        }
+        else {
+            delete *std::launder(reinterpret_cast<Fn**>(s));
+        }
+    }
+
+    template<typename Fn>
+    static constexpr vtable vtable_for = { &invoke_fn<Fn>, &move_fn<Fn>,
+                                           &destroy_fn<Fn> };
+
+    storage_type storage_;
+    const vtable* vtable_;
+};
+
+}  // namespace dts
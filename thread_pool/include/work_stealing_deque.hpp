@@ -0,0 +1,165 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace dts {
+
+/**
+ * A Chase-Lev work-stealing deque.
+ *
+ * The owner thread pushes and pops at the bottom (LIFO) without taking any
+ * lock, while any other thread may steal from the top (FIFO). The ring buffer
+ * grows on demand. Retired buffers are kept alive until the deque itself is
+ * destroyed because a thief may still be reading from them.
+ *
+ * Memory orderings follow "Correct and Efficient Work-Stealing for Weak Memory
+ * Models" (Le et al., PPoPP 2013).
+ *
+ * T must be trivially copyable: a thief may read a slot that the owner is
+ * overwriting and only finds out afterwards, when its CAS on top_ fails.
+ */
+template<typename T>
+class work_stealing_deque {
+public:
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "T must be trivially copyable");
+
+    using value_type = T;
+    using size_type = std::size_t;
+
+    explicit work_stealing_deque(size_type capacity = 256)
+        : top_(0),
+          bottom_(0),
+          buffer_(nullptr),
+          buffers_() {
+        size_type cap = 1;
+        while (cap < capacity) {
+            cap <<= 1;
+        }
+        buffers_.emplace_back(std::make_unique<ring_buffer>(cap));
+        buffer_.store(buffers_.back().get(), std::memory_order_relaxed);
+    }
+
+    ~work_stealing_deque() = default;
+
+    work_stealing_deque(const work_stealing_deque&) = delete;
+    work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+    // Only the owner thread may call push().
+    void push(value_type item) {
+        const std::int64_t b = bottom_.load(std::memory_order_relaxed);
+        const std::int64_t t = top_.load(std::memory_order_acquire);
+        ring_buffer* buf = buffer_.load(std::memory_order_relaxed);
+        if (b - t > static_cast<std::int64_t>(buf->capacity()) - 1) {
+            buf = grow(buf, b, t);
+        }
+        buf->store(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Only the owner thread may call pop().
+    std::optional<value_type> pop() {
+        const std::int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        ring_buffer* buf = buffer_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = top_.load(std::memory_order_relaxed);
+        if (t > b) {
+            // Empty.
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        value_type item = buf->load(b);
+        if (t == b) {
+            // Last item. Race against thieves for it.
+            const bool won = top_.compare_exchange_strong(
+              t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            if (!won) {
+                return std::nullopt;
+            }
+        }
+        return item;
+    }
+
+    /**
+     * Any thread may call steal(). Returns std::nullopt if the deque is empty
+     * or another thread won the race for the top item.
+     */
+    std::optional<value_type> steal() {
+        std::int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const std::int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t >= b) {
+            return std::nullopt;
+        }
+        ring_buffer* buf = buffer_.load(std::memory_order_acquire);
+        value_type item = buf->load(t);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            return std::nullopt;
+        }
+        return item;
+    }
+
+    // Approximate when called concurrently with push()/pop()/steal().
+    size_type size() const noexcept {
+        const std::int64_t b = bottom_.load(std::memory_order_relaxed);
+        const std::int64_t t = top_.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_type>(b - t) : 0;
+    }
+
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+private:
+    class ring_buffer {
+    public:
+        explicit ring_buffer(size_type capacity)
+            : mask_(capacity - 1),
+              slots_(std::make_unique<std::atomic<value_type>[]>(capacity)) {}
+
+        size_type capacity() const noexcept {
+            return mask_ + 1;
+        }
+
+        value_type load(std::int64_t i) const noexcept {
+            return slots_[static_cast<size_type>(i) & mask_].load(
+              std::memory_order_relaxed);
+        }
+
+        void store(std::int64_t i, value_type item) noexcept {
+            slots_[static_cast<size_type>(i) & mask_].store(
+              item, std::memory_order_relaxed);
+        }
+
+    private:
+        const size_type mask_;
+        std::unique_ptr<std::atomic<value_type>[]> slots_;
+    };
+
+    alignas(64) std::atomic<std::int64_t> top_;
+    alignas(64) std::atomic<std::int64_t> bottom_;
+    std::atomic<ring_buffer*> buffer_;
+    // Owned by the owner thread. Includes retired buffers.
+    std::vector<std::unique_ptr<ring_buffer>> buffers_;
+
+    ring_buffer* grow(ring_buffer* old_buf, std::int64_t b, std::int64_t t) {
+        auto new_buf = std::make_unique<ring_buffer>(old_buf->capacity() << 1);
+        for (std::int64_t i = t; i < b; ++i) {
+            new_buf->store(i, old_buf->load(i));
+        }
+        ring_buffer* raw = new_buf.get();
+        buffers_.emplace_back(std::move(new_buf));
+        buffer_.store(raw, std::memory_order_release);
+        return raw;
+    }
+};
+
+}  // namespace dts
@@ -0,0 +1,221 @@
+#include "bounded_task_queue.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+#include "thread_pool_overloaded.hpp"
+#include "thread_pool_stopped.hpp"
+
+namespace dts {
+
+bounded_task_queue::bounded_task_queue(size_type capacity,
+                                       overflow_policy overflow,
+                                       size_type starvation_limit)
+    : overflow_(overflow),
+      starvation_limit_(std::max<size_type>(starvation_limit, 1)),
+      accept_push_(true),
+      pushing_(0),
+      retire_cnt_(0),
+      rings_{ { ring_type(capacity), ring_type(capacity),
+                ring_type(capacity) } },
+      skipped_(),
+      pollers_(),
+      producers_() {
+    static_assert(task_priority_count == 3, "one ring per priority");
+}
+
+void bounded_task_queue::push(task_type&& task, task_priority priority) {
+    size_type unnotified = 0;
+    push_one(task, rings_[static_cast<size_type>(priority)], unnotified);
+    pollers_.notify(unnotified);
+}
+
+bool bounded_task_queue::try_push(task_type& task, task_priority priority) {
+    if (!push_if_accepted(task, rings_[static_cast<size_type>(priority)])) {
+        return false;
+    }
+    pollers_.notify(1);
+    return true;
+}
+
+void bounded_task_queue::push_bulk(std::vector<task_type>& tasks,
+                                   task_priority priority) {
+    ring_type& ring = rings_[static_cast<size_type>(priority)];
+    size_type unnotified = 0;
+    for (task_type& task : tasks) {
+        push_one(task, ring, unnotified);
+    }
+    pollers_.notify(unnotified);
+}
+
+bounded_task_queue::task_type bounded_task_queue::poll() {
+    return std::move(*poll_with([this](auto& ready) {
+        pollers_.wait(ready);
+        return true;
+    }));
+}
+
+std::optional<bounded_task_queue::task_type> bounded_task_queue::poll_for(
+  std::chrono::nanoseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    return poll_with([this, deadline](auto& ready) {
+        return pollers_.wait_until(ready, deadline);
+    });
+}
+
+template<typename Wait>
+std::optional<bounded_task_queue::task_type> bounded_task_queue::poll_with(
+  Wait&& wait) {
+    auto ready = [this]() {
+        return !empty() || !accept_push_.load() || retire_cnt_.load() != 0;
+    };
+    while (true) {
+        if (claim_retirement()) {
+            throw thread_pool_stopped("bounded_task_queue::poll() retired by "
+                                      "retire_pollers().");
+        }
+        if (auto task = try_poll()) {
+            return task;
+        }
+        if (!accept_push_.load()) {
+            // A task may have been pushed right before stopping.
+            await_producers();
+            if (auto task = try_poll()) {
+                return task;
+            }
+            throw thread_pool_stopped("bounded_task_queue is empty and "
+                                      "poll() called after stopping push.");
+        }
+        if (!wait(ready)) {
+            return try_poll();
+        }
+    }
+}
+
+bool bounded_task_queue::claim_retirement() noexcept {
+    size_type cnt = retire_cnt_.load(std::memory_order_relaxed);
+    while (cnt != 0) {
+        if (retire_cnt_.compare_exchange_weak(cnt, cnt - 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<bounded_task_queue::task_type> bounded_task_queue::try_poll() {
+    std::optional<task_type> task;
+    size_type served = 0;
+    // A starving lane behind a non-empty higher one goes first.
+    bool higher_pending = false;
+    for (size_type i = 0; i < task_priority_count && !task; ++i) {
+        if (rings_[i].empty()) {
+            continue;
+        }
+        if (higher_pending &&
+            skipped_[i].load(std::memory_order_relaxed) >= starvation_limit_) {
+            task = rings_[i].try_pop();
+            served = i;
+        }
+        higher_pending = true;
+    }
+    for (size_type i = 0; i < task_priority_count && !task; ++i) {
+        task = rings_[i].try_pop();
+        served = i;
+    }
+    if (!task) {
+        return task;
+    }
+    // Only touch the counters when there is something to account for.
+    if (skipped_[served].load(std::memory_order_relaxed) != 0) {
+        skipped_[served].store(0, std::memory_order_relaxed);
+    }
+    for (size_type i = 0; i < task_priority_count; ++i) {
+        if (i != served && !rings_[i].empty()) {
+            skipped_[i].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    producers_.notify(1);
+    return task;
+}
+
+bool bounded_task_queue::empty() {
+    for (const ring_type& ring : rings_) {
+        if (!ring.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool bounded_task_queue::empty(task_priority priority) {
+    return rings_[static_cast<size_type>(priority)].empty();
+}
+
+void bounded_task_queue::stop_push() {
+    accept_push_.store(false);
+    await_producers();
+    pollers_.notify_all();
+    producers_.notify_all();
+}
+
+void bounded_task_queue::retire_pollers(size_type cnt) {
+    retire_cnt_.fetch_add(cnt);
+    pollers_.notify_all();
+}
+
+bool bounded_task_queue::push_if_accepted(task_type& task, ring_type& ring) {
+    /**
+     * Both are sequentially consistent, as are the store and the loads in
+     * stop_push(), so either this sees accept_push_ cleared, or stop_push()
+     * sees this producer and waits for it.
+     */
+    pushing_.fetch_add(1);
+    if (!accept_push_.load()) {
+        pushing_.fetch_sub(1);
+        throw thread_pool_stopped(
+          "bounded_task_queue::push() called after stopping push.");
+    }
+    const bool pushed = ring.try_push(std::move(task));
+    pushing_.fetch_sub(1);
+    return pushed;
+}
+
+void bounded_task_queue::await_producers() noexcept {
+    while (pushing_.load() != 0) {
+        std::this_thread::yield();
+    }
+}
+
+void bounded_task_queue::push_one(task_type& task, ring_type& ring,
+                                  size_type& unnotified) {
+    while (true) {
+        if (push_if_accepted(task, ring)) {
+            ++unnotified;
+            return;
+        }
+        /**
+         * Pollers must know about what's already in the ring before this
+         * thread waits for them to make room.
+         */
+        pollers_.notify(unnotified);
+        unnotified = 0;
+        switch (overflow_) {
+        case overflow_policy::block:
+            producers_.wait([this, &ring]() {
+                return ring.size() < ring.capacity() || !accept_push_.load();
+            });
+            break;
+        case overflow_policy::spin:
+            std::this_thread::yield();
+            break;
+        case overflow_policy::reject:
+            throw thread_pool_overloaded("bounded_task_queue is full.");
+        case overflow_policy::run_in_caller:
+            std::invoke(task);
+            return;
+        }
+    }
+}
+
+}  // namespace dts
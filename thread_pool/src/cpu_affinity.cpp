@@ -0,0 +1,65 @@
+#include "cpu_affinity.hpp"
+
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace dts {
+
+#if defined(__linux__)
+
+std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+bool pin_current_thread(const std::vector<int>& cpus) noexcept {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            return false;
+        }
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+int current_cpu() noexcept {
+    return sched_getcpu();
+}
+
+#else
+
+std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+    const int cpu_cnt = static_cast<int>(std::thread::hardware_concurrency());
+    for (int cpu = 0; cpu < cpu_cnt; ++cpu) {
+        cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+bool pin_current_thread(const std::vector<int>&) noexcept {
+    return false;
+}
+
+int current_cpu() noexcept {
+    return -1;
+}
+
+#endif
+
+}  // namespace dts
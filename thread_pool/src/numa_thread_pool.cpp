@@ -0,0 +1,49 @@
+#include "numa_thread_pool.hpp"
+
+#include "cpu_affinity.hpp"
+
+namespace dts {
+
+numa_thread_pool::numa_thread_pool(size_type workers_per_node,
+                                   const thread_pool_options& options,
+                                   const std::vector<numa_node>& nodes)
+    : nodes_(nodes), pools_(), node_of_cpu_() {
+    for (size_type i = 0; i < nodes_.size(); ++i) {
+        const numa_node& node = nodes_[i];
+        thread_pool_options node_options = options;
+        node_options.cpu_affinity = node.cpus;
+        const size_type worker_cnt =
+          workers_per_node != 0 ? workers_per_node : node.cpus.size();
+        pools_.push_back(
+          std::make_unique<thread_pool>(worker_cnt, node_options));
+        for (int cpu : node.cpus) {
+            const auto cpu_index = static_cast<size_type>(cpu);
+            if (cpu_index >= node_of_cpu_.size()) {
+                node_of_cpu_.resize(cpu_index + 1, 0);
+            }
+            node_of_cpu_[cpu_index] = i;
+        }
+    }
+}
+
+numa_thread_pool::size_type numa_thread_pool::local_node() const noexcept {
+    const int cpu = current_cpu();
+    if (cpu < 0 || static_cast<size_type>(cpu) >= node_of_cpu_.size()) {
+        return 0;
+    }
+    return node_of_cpu_[cpu];
+}
+
+void numa_thread_pool::wait_idle() {
+    for (auto& pool : pools_) {
+        pool->wait_idle();
+    }
+}
+
+void numa_thread_pool::shutdown(bool drain) {
+    for (auto& pool : pools_) {
+        pool->shutdown(drain);
+    }
+}
+
+}  // namespace dts
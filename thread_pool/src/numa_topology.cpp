@@ -0,0 +1,85 @@
+#include "numa_topology.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "cpu_affinity.hpp"
+
+namespace dts {
+
+std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    std::istringstream iss(list);
+    std::string range;
+    while (std::getline(iss, range, ',')) {
+        range.erase(std::remove_if(range.begin(), range.end(),
+                                   [](unsigned char c) {
+                                       return std::isspace(c);
+                                   }),
+                    range.end());
+        if (range.empty()) {
+            continue;
+        }
+        const auto dash = range.find('-');
+        try {
+            const int first = std::stoi(range.substr(0, dash));
+            const int last = dash == std::string::npos ?
+                               first :
+                               std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        } catch (std::logic_error&) {
+            throw std::invalid_argument("Malformed CPU list: " + list);
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::vector<numa_node> numa_nodes(const std::string& sysfs_root) {
+    namespace fs = std::filesystem;
+    const std::vector<int> allowed = allowed_cpus();
+    std::vector<numa_node> nodes;
+    std::error_code ec;
+    for (fs::directory_iterator it(sysfs_root, ec), end; !ec && it != end;
+         it.increment(ec)) {
+        const std::string name = it->path().filename().string();
+        if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+            !std::all_of(name.begin() + 4, name.end(), [](unsigned char c) {
+                return std::isdigit(c);
+            })) {
+            continue;
+        }
+        std::ifstream ifs(it->path() / "cpulist");
+        std::string list;
+        if (!std::getline(ifs, list)) {
+            continue;
+        }
+        numa_node node{ std::stoi(name.substr(4)), {} };
+        for (int cpu : parse_cpu_list(list)) {
+            if (std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+                node.cpus.push_back(cpu);
+            }
+        }
+        // Memory-only nodes and nodes outside our cpuset.
+        if (!node.cpus.empty()) {
+            nodes.push_back(std::move(node));
+        }
+    }
+    if (nodes.empty()) {
+        nodes.push_back(numa_node{ 0, allowed });
+    }
+    std::sort(nodes.begin(), nodes.end(),
+              [](const numa_node& lhs, const numa_node& rhs) {
+                  return lhs.id < rhs.id;
+              });
+    return nodes;
+}
+
+}  // namespace dts
@@ -0,0 +1,166 @@
+#include "task_graph.hpp"
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+
+namespace dts {
+
+// Everything a single run shares between the nodes' tasks.
+class task_graph::run_state
+    : public std::enable_shared_from_this<task_graph::run_state> {
+public:
+    run_state(task_graph& graph, thread_pool& pool)
+        : graph_(graph),
+          pool_(pool),
+          remaining_(std::make_unique<std::atomic<size_type>[]>(
+            graph.nodes_.size())),
+          unfinished_(graph.nodes_.size()),
+          failed_(false),
+          error_(),
+          prom_() {
+        for (size_type i = 0; i < graph_.nodes_.size(); ++i) {
+            remaining_[i].store(graph_.nodes_[i].dependency_cnt,
+                                std::memory_order_relaxed);
+        }
+    }
+
+    future<void> get_future() {
+        return prom_.get_future();
+    }
+
+    void start() {
+        for (node_id id = 0; id < graph_.nodes_.size(); ++id) {
+            if (graph_.nodes_[id].dependency_cnt == 0) {
+                schedule(id);
+            }
+        }
+    }
+
+private:
+    task_graph& graph_;
+    thread_pool& pool_;
+    // Dependencies of each node that haven't run yet.
+    const std::unique_ptr<std::atomic<size_type>[]> remaining_;
+    std::atomic<size_type> unfinished_;
+    std::atomic<bool> failed_;
+    // Only the first exception is kept.
+    std::exception_ptr error_;
+    detail::task_promise<void> prom_;
+
+    void schedule(node_id id) noexcept {
+        try {
+            pool_.post([self = shared_from_this(), id]() {
+                self->run_node(id);
+            });
+        } catch (...) {
+            // Skips this node and, through it, everything that's left.
+            fail(std::current_exception());
+            run_node(id);
+        }
+    }
+
+    void run_node(node_id id) noexcept {
+        while (true) {
+            node& n = graph_.nodes_[id];
+            if (!failed_.load(std::memory_order_relaxed)) {
+                try {
+                    std::invoke(n.fn);
+                } catch (...) {
+                    fail(std::current_exception());
+                }
+            }
+            // Keeps one runnable successor for this thread.
+            node_id next = graph_.nodes_.size();
+            for (node_id succ : n.successors) {
+                const size_type left =
+                  remaining_[succ].fetch_sub(1, std::memory_order_acq_rel) - 1;
+                if (left != 0) {
+                    continue;
+                }
+                if (next == graph_.nodes_.size()) {
+                    next = succ;
+                }
+                else {
+                    schedule(succ);
+                }
+            }
+            if (unfinished_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                finish();
+                return;
+            }
+            if (next == graph_.nodes_.size()) {
+                return;
+            }
+            id = next;
+        }
+    }
+
+    void fail(std::exception_ptr error) noexcept {
+        if (!failed_.exchange(true)) {
+            error_ = std::move(error);
+        }
+    }
+
+    void finish() noexcept {
+        prom_.fulfill([this]() {
+            if (error_) {
+                std::rethrow_exception(error_);
+            }
+        });
+    }
+};
+
+void task_graph::precede(node_id before, node_id after) {
+    if (before >= nodes_.size() || after >= nodes_.size()) {
+        throw std::out_of_range(
+          "task_graph::precede() called with an unknown node.");
+    }
+    nodes_[before].successors.push_back(after);
+    ++nodes_[after].dependency_cnt;
+}
+
+future<void> task_graph::run(thread_pool& pool) {
+    if (has_cycle()) {
+        throw std::invalid_argument("task_graph::run() called on a cycle.");
+    }
+    if (nodes_.empty()) {
+        promise<void> prom;
+        prom.set_value();
+        return prom.get_future().via(pool);
+    }
+    auto state = std::make_shared<run_state>(*this, pool);
+    future<void> result = state->get_future().via(pool);
+    state->start();
+    return result;
+}
+
+// Kahn's algorithm: a cycle is left over once no node without
+// dependencies remains.
+bool task_graph::has_cycle() const {
+    std::vector<size_type> remaining;
+    std::vector<node_id> ready;
+    remaining.reserve(nodes_.size());
+    for (node_id id = 0; id < nodes_.size(); ++id) {
+        remaining.push_back(nodes_[id].dependency_cnt);
+        if (remaining.back() == 0) {
+            ready.push_back(id);
+        }
+    }
+    size_type visited = 0;
+    while (!ready.empty()) {
+        const node_id id = ready.back();
+        ready.pop_back();
+        ++visited;
+        for (node_id succ : nodes_[id].successors) {
+            if (--remaining[succ] == 0) {
+                ready.push_back(succ);
+            }
+        }
+    }
+    return visited != nodes_.size();
+}
+
+}  // namespace dts
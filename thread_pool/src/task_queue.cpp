@@ -1,19 +1,88 @@
 #include "task_queue.hpp"
 
+#include <algorithm>
+
 namespace dts {
 
+task_queue::task_queue(size_type starvation_limit)
+    : starvation_limit_(std::max<size_type>(starvation_limit, 1)) {}
+
+void task_queue::push(task_type&& task, task_priority priority) {
+    {
+        std::unique_lock<std::mutex> ulock(mtx_);
+        if (!accept_push_) {
+            throw thread_pool_stopped(
+              "task_queue::push() called after stopping push.");
+        }
+        push_back(std::move(task), priority);
+    }
+    cv_.notify_one();
+}
+
+void task_queue::push_bulk(std::vector<task_type>& tasks,
+                           task_priority priority) {
+    size_type wake_cnt = 0;
+    bool wake_all = false;
+    {
+        std::unique_lock<std::mutex> ulock(mtx_);
+        if (!accept_push_) {
+            throw thread_pool_stopped(
+              "task_queue::push_bulk() called after stopping push.");
+        }
+        for (task_type& task : tasks) {
+            push_back(std::move(task), priority);
+        }
+        wake_cnt = std::min(tasks.size(), waiting_cnt_);
+        wake_all = wake_cnt == waiting_cnt_;
+    }
+    if (wake_all) {
+        cv_.notify_all();
+        return;
+    }
+    while (wake_cnt--) {
+        cv_.notify_one();
+    }
+}
+
 task_queue::task_type task_queue::poll() {
     std::unique_lock<std::mutex> ulock(mtx_);
+    ++waiting_cnt_;
     cv_.wait(ulock, [this]() {
-        return !accept_push_ || !q_.empty();
+        return poll_ready();
     });
-    if (!accept_push_ && q_.empty()) {
-        throw thread_pool_stopped("task_queue is empty and task_queue::poll() "
-                                  "called after stopping push.");
+    --waiting_cnt_;
+    return take_polled();
+}
+
+std::optional<task_queue::task_type> task_queue::poll_for(
+  std::chrono::nanoseconds timeout) {
+    std::unique_lock<std::mutex> ulock(mtx_);
+    ++waiting_cnt_;
+    const bool ready = cv_.wait_for(ulock, timeout, [this]() {
+        return poll_ready();
+    });
+    --waiting_cnt_;
+    if (!ready) {
+        return std::nullopt;
     }
-    task_type task = std::move(q_.front());
-    q_.pop();
-    return task;
+    return take_polled();
+}
+
+std::optional<task_queue::task_type> task_queue::try_poll() {
+    std::lock_guard<std::mutex> lkgrd(mtx_);
+    if (size_ == 0) {
+        return std::nullopt;
+    }
+    return pop_front();
+}
+
+bool task_queue::empty() {
+    return size_.load(std::memory_order_relaxed) == 0;
+}
+
+bool task_queue::empty(task_priority priority) {
+    const lane& l = lanes_[static_cast<size_type>(priority)];
+    return l.size.load(std::memory_order_relaxed) == 0;
 }
 
 void task_queue::stop_push() {
@@ -24,4 +93,81 @@ void task_queue::stop_push() {
     cv_.notify_all();
 }
 
+void task_queue::retire_pollers(size_type cnt) {
+    {
+        std::unique_lock<std::mutex> ulock(mtx_);
+        retire_cnt_ += cnt;
+    }
+    cv_.notify_all();
+}
+
+bool task_queue::poll_ready() const noexcept {
+    return !accept_push_ || retire_cnt_ != 0 || size_ != 0;
+}
+
+task_queue::task_type task_queue::take_polled() {
+    if (retire_cnt_ != 0) {
+        --retire_cnt_;
+        throw thread_pool_stopped(
+          "task_queue::poll() retired by task_queue::retire_pollers().");
+    }
+    if (!accept_push_ && size_ == 0) {
+        throw thread_pool_stopped("task_queue is empty and task_queue::poll() "
+                                  "called after stopping push.");
+    }
+    return pop_front();
+}
+
+void task_queue::push_back(task_type&& task, task_priority priority) {
+    lane& l = lanes_[static_cast<size_type>(priority)];
+    const size_type size = l.size.load(std::memory_order_relaxed);
+    if (size == l.ring.size()) {
+        std::vector<task_type> bigger(l.ring.empty() ? 16 : l.ring.size() * 2);
+        for (size_type i = 0; i < size; ++i) {
+            bigger[i] = std::move(l.ring[(l.head + i) % l.ring.size()]);
+        }
+        l.ring.swap(bigger);
+        l.head = 0;
+    }
+    l.ring[(l.head + size) % l.ring.size()] = std::move(task);
+    l.size.store(size + 1, std::memory_order_relaxed);
+    size_.store(size_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+}
+
+task_queue::task_type task_queue::pop_front() {
+    /**
+     * The first non-empty lane wins unless a lower one has been skipped too
+     * often. With only one lane in use this is a couple of compares.
+     */
+    size_type chosen = task_priority_count;
+    for (size_type i = 0; i < task_priority_count; ++i) {
+        if (lanes_[i].size.load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+        if (chosen == task_priority_count) {
+            chosen = i;
+        }
+        else if (lanes_[i].skipped >= starvation_limit_) {
+            chosen = i;
+            break;
+        }
+    }
+    for (size_type i = 0; i < task_priority_count; ++i) {
+        lane& l = lanes_[i];
+        if (i != chosen && l.size.load(std::memory_order_relaxed) != 0) {
+            ++l.skipped;
+        }
+    }
+    lane& l = lanes_[chosen];
+    l.skipped = 0;
+    task_type task = std::move(l.ring[l.head]);
+    l.head = (l.head + 1) % l.ring.size();
+    l.size.store(l.size.load(std::memory_order_relaxed) - 1,
+                 std::memory_order_relaxed);
+    size_.store(size_.load(std::memory_order_relaxed) - 1,
+                std::memory_order_relaxed);
+    return task;
+}
+
 }  // namespace dts
@@ -1,32 +1,839 @@
 #include "thread_pool.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include "block_pool.hpp"
+#include "bounded_task_queue.hpp"
+#include "cpu_affinity.hpp"
+#include "cpu_relax.hpp"
+#include "task_queue.hpp"
+
 namespace dts {
 
-thread_pool::thread_pool(size_type worker_cnt) : tq_(), workers_() {
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct worker_context {
+    const thread_pool* pool = nullptr;
+    // Index of the worker's deque in work-stealing mode.
+    thread_pool::size_type index = 0;
+#if DTS_THREAD_POOL_STATS
+    detail::worker_counters* counters = nullptr;
+#endif
+};
+
+thread_local worker_context this_worker;
+
+// Slots for tasks in the local deques, which only hold pointers.
+using task_slot_pool = block_pool<sizeof(thread_pool::task_type)>;
+
+thread_pool::task_type* make_task_slot(thread_pool::task_type&& task) {
+    void* p = task_slot_pool::allocate();
+    return ::new (p) thread_pool::task_type(std::move(task));
+}
+
+thread_pool::task_type take_task_slot(thread_pool::task_type* slot) {
+    thread_pool::task_type task(std::move(*slot));
+    slot->~unique_task();
+    task_slot_pool::deallocate(slot);
+    return task;
+}
+
+std::unique_ptr<basic_task_queue> make_task_queue(
+  const thread_pool_options& options) {
+    if (options.queue_capacity == 0) {
+        return std::make_unique<task_queue>(options.starvation_limit);
+    }
+    // The pool runs overflowing tasks itself so that it can account for them.
+    const overflow_policy overflow =
+      options.overflow == overflow_policy::run_in_caller ?
+        overflow_policy::reject :
+        options.overflow;
+    return std::make_unique<bounded_task_queue>(
+      options.queue_capacity, overflow, options.starvation_limit);
+}
+
+// Queued tasks have been moved out, the others are still there.
+thread_pool::size_type count_unqueued(
+  std::vector<thread_pool::task_type>::const_iterator first,
+  std::vector<thread_pool::task_type>::const_iterator last) {
+    return std::count_if(first, last, [](const thread_pool::task_type& task) {
+        return static_cast<bool>(task);
+    });
+}
+
+#if DTS_THREAD_POOL_STATS
+// Wraps task so that the worker running it records how long it waited.
+thread_pool::task_type stamp_task(const thread_pool* pool,
+                                  thread_pool::task_type&& task) {
+    return thread_pool::task_type(
+      [pool, task = std::move(task), submitted = clock_type::now()]() mutable {
+          if (this_worker.pool == pool && this_worker.counters != nullptr) {
+              this_worker.counters->queue_wait.record(clock_type::now() -
+                                                      submitted);
+          }
+          std::invoke(task);
+      });
+}
+#endif
+
+// A worker's idle strategy: spin, then yield, then let the caller park.
+class idle_spinner {
+public:
+    explicit idle_spinner(const thread_pool_options& options)
+        : max_spin_cnt_(options.spin_count),
+          // At least 1, or halving would stop spinning for good.
+          min_spin_cnt_(options.adaptive_spin && options.spin_count != 0 ?
+                          std::max<std::size_t>(1, options.spin_count / 16) :
+                          options.spin_count),
+          yield_cnt_(options.yield_count),
+          spin_cnt_(options.spin_count) {}
+
+    /**
+     * Calls find() until it returns a task or the budget runs out, in which
+     * case the caller should park. Returns right away if spinning and
+     * yielding are both disabled.
+     */
+    template<typename Find>
+    std::optional<thread_pool::task_type> spin(Find&& find) {
+        if (spin_cnt_ == 0 && yield_cnt_ == 0) {
+            return std::nullopt;
+        }
+        for (std::size_t i = 0; i < spin_cnt_; ++i) {
+            if (auto task = find()) {
+                if (i != 0) {
+                    // Spinning paid off.
+                    spin_cnt_ = std::min(max_spin_cnt_, spin_cnt_ * 2);
+                }
+                return task;
+            }
+            cpu_relax();
+        }
+        for (std::size_t i = 0; i < yield_cnt_; ++i) {
+            if (auto task = find()) {
+                // Spinning a little longer would have caught it.
+                spin_cnt_ = std::min(max_spin_cnt_, spin_cnt_ * 2);
+                return task;
+            }
+            std::this_thread::yield();
+        }
+        spin_cnt_ = std::max(min_spin_cnt_, spin_cnt_ / 2);
+        return std::nullopt;
+    }
+
+private:
+    const std::size_t max_spin_cnt_;
+    const std::size_t min_spin_cnt_;
+    const std::size_t yield_cnt_;
+    std::size_t spin_cnt_;
+};
+
+}  // namespace
+
+#if DTS_THREAD_POOL_STATS
+worker_stats detail::worker_counters::snapshot() const noexcept {
+    worker_stats result;
+    result.tasks_executed = tasks_executed.load(std::memory_order_relaxed);
+    result.tasks_stolen = tasks_stolen.load(std::memory_order_relaxed);
+    result.busy_time =
+      std::chrono::nanoseconds(busy_ns.load(std::memory_order_relaxed));
+    result.idle_time =
+      std::chrono::nanoseconds(idle_ns.load(std::memory_order_relaxed));
+    result.queue_wait = queue_wait.snapshot();
+    result.run_time = run_time.snapshot();
+    return result;
+}
+#endif
+
+thread_pool::thread_pool(size_type worker_cnt,
+                         const thread_pool_options& options)
+    : options_(options),
+      tq_(make_task_queue(options)),
+      local_queues_(),
+      stopping_(false),
+      idle_workers_(),
+      retire_cnt_(0),
+      pending_(0),
+      idle_waiters_(),
+      discarding_(false),
+      dropped_(0),
+      shutdown_mtx_(),
+      worker_cnt_(0),
+      workers_mtx_(),
+      worker_exited_cv_(),
+      accept_workers_(true),
+      workers_(),
+      free_slots_(),
+      next_cpu_(0),
+      pin_failures_(0),
+#if DTS_THREAD_POOL_STATS
+      retired_stats_(),
+#endif
+      next_worker_id_(0) {
+    if (!options_.cpu_affinity.empty()) {
+        const std::vector<int> allowed = allowed_cpus();
+        for (int cpu : options_.cpu_affinity) {
+            if (!std::binary_search(allowed.begin(), allowed.end(), cpu)) {
+                throw std::invalid_argument(
+                  "thread_pool_options::cpu_affinity names a CPU the process "
+                  "may not run on.");
+            }
+        }
+    }
+    if (options_.max_workers != 0) {
+        worker_cnt = std::clamp(worker_cnt, options_.min_workers,
+                                options_.max_workers);
+    }
+    if (options_.work_stealing) {
+        const size_type slot_cnt = std::max(worker_cnt, options_.max_workers);
+        for (size_type i = 0; i < slot_cnt; ++i) {
+            local_queues_.emplace_back(std::make_unique<local_queue_type>());
+        }
+        // Low slots are handed out first.
+        for (size_type i = slot_cnt; i-- != 0;) {
+            free_slots_.push_back(i);
+        }
+    }
+    std::unique_lock<std::mutex> ulock(workers_mtx_);
+    worker_cnt_.store(worker_cnt);
     while (worker_cnt--) {
-        workers_.emplace_back([this]() {
-            worker_func();
-        });
+        spawn_worker(ulock, false);
     }
 }
 
 thread_pool::~thread_pool() {
-    tq_.stop_push();
-    for (std::thread& worker : workers_) {
-        worker.join();
+    shutdown();
+}
+
+void thread_pool::dispatch(unique_task&& task) {
+    schedule(std::move(task), task_priority::normal);
+}
+
+void thread_pool::shutdown(bool drain) {
+    if (!drain) {
+        shutdown_now();
+        return;
     }
+    stop_and_join();
 }
 
-void thread_pool::worker_func() {
-    task_type task;
-    while (true) {
+thread_pool::size_type thread_pool::shutdown_now() {
+    discarding_.store(true);
+    stop_and_join();
+    // Whatever the workers left behind, e.g. if there are none.
+    while (auto task = tq_->try_poll()) {
+        execute(*task);
+    }
+    return dropped_.exchange(0);
+}
+
+void thread_pool::resize(size_type worker_cnt) {
+    if (options_.max_workers != 0) {
+        worker_cnt = std::clamp(worker_cnt, options_.min_workers,
+                                options_.max_workers);
+    }
+    std::unique_lock<std::mutex> ulock(workers_mtx_);
+    if (!accept_workers_) {
+        throw thread_pool_stopped(
+          "thread_pool::resize() called after stopping the pool.");
+    }
+    if (options_.work_stealing && worker_cnt > local_queues_.size()) {
+        throw std::invalid_argument(
+          "thread_pool::resize() called with more workers than deques.");
+    }
+    const size_type old_cnt = worker_cnt_.exchange(worker_cnt);
+    if (old_cnt >= worker_cnt) {
+        retire_workers(old_cnt - worker_cnt);
+        return;
+    }
+    size_type spawn_cnt = worker_cnt - old_cnt;
+    if (options_.work_stealing) {
+        // Workers that haven't acted on a retirement yet can simply stay.
+        size_type retire_cnt = retire_cnt_.load();
+        while (retire_cnt != 0) {
+            const size_type cancel_cnt = std::min(retire_cnt, spawn_cnt);
+            if (retire_cnt_.compare_exchange_weak(retire_cnt,
+                                                  retire_cnt - cancel_cnt)) {
+                spawn_cnt -= cancel_cnt;
+                break;
+            }
+        }
+    }
+    while (spawn_cnt--) {
+        spawn_worker(ulock, true);
+    }
+}
+
+thread_pool_stats thread_pool::stats() const {
+    thread_pool_stats result;
+    result.pending_tasks = pending_.load(std::memory_order_relaxed);
+    result.pin_failures = pin_failures_.load(std::memory_order_relaxed);
+#if DTS_THREAD_POOL_STATS
+    std::lock_guard<std::mutex> lkgrd(workers_mtx_);
+    result.workers.reserve(workers_.size());
+    for (const auto& w : workers_) {
+        result.workers.push_back(w->counters.snapshot());
+        result.workers.back().id = w->id;
+        if (w->counters.running.load(std::memory_order_relaxed)) {
+            ++result.running_tasks;
+        }
+    }
+    result.retired = retired_stats_;
+#endif
+    return result;
+}
+
+void thread_pool::wait_idle() {
+    while (pending_.load() != 0) {
+        idle_waiters_.wait([this]() {
+            return pending_.load() == 0;
+        });
+    }
+}
+
+void thread_pool::stop_and_join() {
+    std::lock_guard<std::mutex> lkgrd(shutdown_mtx_);
+    tq_->stop_push();
+    if (options_.work_stealing) {
+        stopping_.store(true);
+        idle_workers_.notify_all();
+    }
+    std::vector<std::unique_ptr<worker>> workers;
+    {
+        std::lock_guard<std::mutex> workers_lkgrd(workers_mtx_);
+        accept_workers_ = false;
+        workers.swap(workers_);
+    }
+    // Wakes resize() if it's waiting for a slot.
+    worker_exited_cv_.notify_all();
+    for (auto& w : workers) {
+        w->thread.join();
+    }
+#if DTS_THREAD_POOL_STATS
+    std::lock_guard<std::mutex> workers_lkgrd(workers_mtx_);
+    for (auto& w : workers) {
+        retired_stats_.merge(w->counters.snapshot());
+    }
+#endif
+}
+
+bool thread_pool::spawn_worker(std::unique_lock<std::mutex>& ulock,
+                               bool wait_for_slot) {
+    reap_workers();
+    size_type slot = 0;
+    if (options_.work_stealing) {
+        if (free_slots_.empty() && wait_for_slot) {
+            // Retired workers are on their way out.
+            worker_exited_cv_.wait(ulock, [this]() {
+                reap_workers();
+                return !free_slots_.empty() || !accept_workers_;
+            });
+        }
+        if (free_slots_.empty()) {
+            return false;
+        }
+        slot = free_slots_.back();
+    }
+    if (!accept_workers_) {
+        return false;
+    }
+    workers_.push_back(std::make_unique<worker>());
+    worker& self = *workers_.back();
+    self.slot = slot;
+    self.id = next_worker_id_++;
+    if (options_.pin_one_cpu_per_worker && !options_.cpu_affinity.empty()) {
+        self.cpu =
+          options_.cpu_affinity[next_cpu_++ % options_.cpu_affinity.size()];
+    }
+    try {
+        self.thread = std::thread([this, &self]() {
+            worker_main(self);
+        });
+    } catch (...) {
+        workers_.pop_back();
+        throw;
+    }
+    if (options_.work_stealing) {
+        free_slots_.pop_back();
+    }
+    return true;
+}
+
+// Joins exited workers. Must be called under workers_mtx_.
+void thread_pool::reap_workers() {
+    for (size_type i = 0; i < workers_.size();) {
+        worker& w = *workers_[i];
+        if (!w.exited) {
+            ++i;
+            continue;
+        }
+        w.thread.join();
+        if (options_.work_stealing) {
+            free_slots_.push_back(w.slot);
+        }
+#if DTS_THREAD_POOL_STATS
+        retired_stats_.merge(w.counters.snapshot());
+#endif
+        workers_[i] = std::move(workers_.back());
+        workers_.pop_back();
+    }
+}
+
+void thread_pool::retire_workers(size_type cnt) {
+    if (cnt == 0) {
+        return;
+    }
+    if (options_.work_stealing) {
+        retire_cnt_.fetch_add(cnt);
+        idle_workers_.notify_all();
+    }
+    else {
+        tq_->retire_pollers(cnt);
+    }
+}
+
+bool thread_pool::retire_idle_worker() noexcept {
+    size_type cnt = worker_cnt_.load(std::memory_order_relaxed);
+    while (cnt > options_.min_workers) {
+        if (!worker_cnt_.compare_exchange_weak(cnt, cnt - 1)) {
+            continue;
+        }
+        if (cnt == 1) {
+            /**
+             * A submitter that saw this worker may not have started another
+             * one. Pairs with the fence in grow_if_needed().
+             */
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (has_pending_task()) {
+                worker_cnt_.fetch_add(1);
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+void thread_pool::grow_if_needed() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    size_type cnt = worker_cnt_.load(std::memory_order_relaxed);
+    if (cnt >= options_.max_workers) {
+        return;
+    }
+    const size_type pending = pending_.load(std::memory_order_relaxed);
+    if (cnt != 0 && pending <= cnt + options_.grow_threshold) {
+        return;
+    }
+    /**
+     * Submitters don't wait for each other here unless there's no worker at
+     * all. Whoever holds the lock is likely adding one already.
+     */
+    std::unique_lock<std::mutex> ulock(workers_mtx_, std::defer_lock);
+    if (cnt == 0) {
+        ulock.lock();
+    }
+    else if (!ulock.try_lock()) {
+        return;
+    }
+    if (!accept_workers_ ||
+        !worker_cnt_.compare_exchange_strong(cnt, cnt + 1)) {
+        return;
+    }
+    if (!spawn_worker(ulock, false)) {
+        worker_cnt_.fetch_sub(1);
+    }
+}
+
+void thread_pool::worker_main(worker& self) {
+    bool pinned = true;
+    if (self.cpu >= 0) {
+        pinned = pin_current_thread({ self.cpu });
+    }
+    else if (!options_.cpu_affinity.empty()) {
+        pinned = pin_current_thread(options_.cpu_affinity);
+    }
+    if (!pinned) {
+        pin_failures_.fetch_add(1, std::memory_order_relaxed);
+    }
+    this_worker.pool = this;
+    this_worker.index = self.slot;
+#if DTS_THREAD_POOL_STATS
+    this_worker.counters = &self.counters;
+    self.idle_since = clock_type::now();
+#endif
+    if (options_.work_stealing) {
+        stealing_worker_func(self);
+    }
+    else {
+        worker_func(self);
+    }
+    {
+        std::lock_guard<std::mutex> lkgrd(workers_mtx_);
+        self.exited = true;
+    }
+    worker_exited_cv_.notify_all();
+}
+
+void thread_pool::schedule(task_type&& task, task_priority priority) {
+#if DTS_THREAD_POOL_STATS
+    if (options_.latency_histograms) {
+        task = stamp_task(this, std::move(task));
+    }
+#endif
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    try {
+        enqueue(std::move(task), priority);
+    } catch (thread_pool_overloaded&) {
+        if (!runs_overflow_in_caller()) {
+            finish_tasks(1);
+            throw;
+        }
+        run_in_caller(task);
+    } catch (...) {
+        finish_tasks(1);
+        throw;
+    }
+    if (options_.max_workers != 0) {
+        grow_if_needed();
+    }
+}
+
+void thread_pool::schedule_bulk(std::vector<task_type>& tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+#if DTS_THREAD_POOL_STATS
+    if (options_.latency_histograms) {
+        for (task_type& task : tasks) {
+            task = stamp_task(this, std::move(task));
+        }
+    }
+#endif
+    pending_.fetch_add(tasks.size(), std::memory_order_relaxed);
+    try {
+        enqueue_bulk(tasks);
+    } catch (thread_pool_overloaded&) {
+        if (!runs_overflow_in_caller()) {
+            finish_tasks(count_unqueued(tasks.begin(), tasks.end()));
+            throw;
+        }
+        for (auto it = tasks.begin(); it != tasks.end(); ++it) {
+            if (!*it) {
+                continue;
+            }
+            try {
+                enqueue(std::move(*it), task_priority::normal);
+            } catch (thread_pool_overloaded&) {
+                try {
+                    run_in_caller(*it);
+                } catch (...) {
+                    finish_tasks(count_unqueued(it + 1, tasks.end()));
+                    throw;
+                }
+            } catch (...) {
+                finish_tasks(count_unqueued(it, tasks.end()));
+                throw;
+            }
+        }
+    } catch (...) {
+        finish_tasks(count_unqueued(tasks.begin(), tasks.end()));
+        throw;
+    }
+    if (options_.max_workers != 0) {
+        grow_if_needed();
+    }
+}
+
+void thread_pool::enqueue(task_type&& task, task_priority priority) {
+    if (!options_.work_stealing) {
+        push_shared(task, priority);
+        return;
+    }
+    // Local deques are FIFO for thieves only, so prioritized tasks bypass them.
+    if (this_worker.pool == this && priority == task_priority::normal) {
+        if (stopping_.load(std::memory_order_relaxed)) {
+            throw thread_pool_stopped(
+              "thread_pool::submit() called after stopping the pool.");
+        }
+        local_queues_[this_worker.index]->push(
+          make_task_slot(std::move(task)));
+    }
+    else {
+        push_shared(task, priority);
+    }
+    wake_workers(1);
+}
+
+void thread_pool::enqueue_bulk(std::vector<task_type>& tasks) {
+    if (!options_.work_stealing) {
+        if (worker_must_not_block()) {
+            for (task_type& task : tasks) {
+                push_shared(task, task_priority::normal);
+            }
+            return;
+        }
+        tq_->push_bulk(tasks);
+        return;
+    }
+    if (this_worker.pool == this) {
+        if (stopping_.load(std::memory_order_relaxed)) {
+            throw thread_pool_stopped(
+              "thread_pool::submit_bulk() called after stopping the pool.");
+        }
+        local_queue_type& local_queue = *local_queues_[this_worker.index];
+        for (task_type& task : tasks) {
+            local_queue.push(make_task_slot(std::move(task)));
+        }
+    }
+    else {
         try {
-            task = tq_.poll();
-        } catch (thread_pool_stopped&) {
-            break;
+            tq_->push_bulk(tasks);
+        } catch (...) {
+            // Some tasks may have made it into the queue.
+            wake_workers(tasks.size());
+            throw;
         }
+    }
+    wake_workers(tasks.size());
+}
+
+void thread_pool::push_shared(task_type& task, task_priority priority) {
+    if (!worker_must_not_block()) {
+        tq_->push(std::move(task), priority);
+        return;
+    }
+    if (!tq_->try_push(task, priority)) {
+        throw thread_pool_overloaded("The queue of the thread_pool is full.");
+    }
+}
+
+bool thread_pool::worker_must_not_block() const noexcept {
+    // Only workers make room in the queue, so they must not wait for it.
+    return options_.queue_capacity != 0 && this_worker.pool == this;
+}
+
+bool thread_pool::runs_overflow_in_caller() const noexcept {
+    if (options_.overflow == overflow_policy::run_in_caller) {
+        return true;
+    }
+    return options_.overflow != overflow_policy::reject &&
+           worker_must_not_block();
+}
+
+void thread_pool::run_in_caller(task_type& task) {
+    // Exceptions propagate to the caller like they would from the queue.
+    try {
+        std::invoke(task);
+    } catch (...) {
+        finish_tasks(1);
+        throw;
+    }
+    finish_tasks(1);
+}
+
+void thread_pool::execute(task_type& task) noexcept {
+    run_or_drop(task);
+    finish_tasks(1);
+}
+
+// Like execute(), accounting for the task in the worker's counters first.
+void thread_pool::execute_on_worker(worker& self, task_type& task) noexcept {
+#if DTS_THREAD_POOL_STATS
+    using detail::worker_counters;
+    worker_counters& counters = self.counters;
+    const auto start = clock_type::now();
+    worker_counters::add<std::int64_t>(
+      counters.idle_ns, (start - self.idle_since).count());
+    counters.running.store(true, std::memory_order_relaxed);
+    if (options_.on_task_start) {
+        options_.on_task_start(self.id);
+    }
+    run_or_drop(task);
+    const auto end = clock_type::now();
+    const std::chrono::nanoseconds run_time = end - start;
+    worker_counters::add<std::int64_t>(counters.busy_ns, run_time.count());
+    worker_counters::add<std::uint64_t>(counters.tasks_executed, 1);
+    counters.running.store(false, std::memory_order_relaxed);
+    if (options_.latency_histograms) {
+        counters.run_time.record(run_time);
+    }
+    if (options_.on_task_end) {
+        options_.on_task_end(self.id, run_time);
+    }
+    self.idle_since = end;
+#else
+    static_cast<void>(self);
+    run_or_drop(task);
+#endif
+    finish_tasks(1);
+}
+
+void thread_pool::run_or_drop(task_type& task) noexcept {
+    if (discarding_.load(std::memory_order_relaxed)) {
+        task.reset();
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+    else {
+        run_task(task);
+    }
+}
+
+void thread_pool::run_task(task_type& task) noexcept {
+    try {
         std::invoke(task);
+    } catch (...) {
+        if (!options_.exception_handler) {
+            std::terminate();
+        }
+        // Throwing from the handler terminates since this is noexcept.
+        options_.exception_handler(std::current_exception());
+    }
+}
+
+void thread_pool::finish_tasks(size_type task_cnt) noexcept {
+    if (pending_.fetch_sub(task_cnt, std::memory_order_acq_rel) == task_cnt) {
+        idle_waiters_.notify(std::numeric_limits<size_type>::max());
+    }
+}
+
+void thread_pool::worker_func(worker& self) {
+    idle_spinner spinner(options_);
+    auto find = [this]() -> std::optional<task_type> {
+        if (tq_->empty()) {
+            return std::nullopt;
+        }
+        return tq_->try_poll();
+    };
+    const bool elastic = options_.max_workers != 0;
+    while (true) {
+        std::optional<task_type> task = spinner.spin(find);
+        if (!task) {
+            try {
+                if (elastic) {
+                    task = tq_->poll_for(options_.idle_timeout);
+                }
+                else {
+                    task = tq_->poll();
+                }
+            } catch (thread_pool_stopped&) {
+                // Stopped or retired.
+                break;
+            }
+        }
+        if (task) {
+            execute_on_worker(self, *task);
+        }
+        else if (retire_idle_worker()) {
+            break;
+        }
+    }
+}
+
+void thread_pool::stealing_worker_func(worker& self) {
+    const size_type index = self.slot;
+    // Start stealing from the right neighbor so that victims spread out.
+    size_type victim = (index + 1) % local_queues_.size();
+    idle_spinner spinner(options_);
+    auto find = [this, index, &victim]() -> std::optional<task_type> {
+        if (!has_pending_task()) {
+            return std::nullopt;
+        }
+        return find_task(index, victim);
+    };
+    while (true) {
+        const bool stopping = stopping_.load();
+        std::optional<task_type> task = find_task(index, victim);
+        if (!task && !stopping) {
+            task = spinner.spin(find);
+        }
+        if (task) {
+            execute_on_worker(self, *task);
+        }
+        else if (stopping) {
+            /**
+             * Nothing can be pushed after stopping_ is set, and every worker
+             * drains its own deque before exiting, so it's safe to leave.
+             */
+            break;
+        }
+        else if (claim_retirement()) {
+            // Only this worker pushes to its deque, and it's empty.
+            break;
+        }
+        else if (!park_worker() && retire_idle_worker()) {
+            break;
+        }
+    }
+}
+
+std::optional<thread_pool::task_type> thread_pool::find_task(
+  size_type index, size_type& victim) {
+    if (!tq_->empty(task_priority::high)) {
+        if (auto task = tq_->try_poll()) {
+            return task;
+        }
+    }
+    if (auto slot = local_queues_[index]->pop()) {
+        return take_task_slot(*slot);
+    }
+    if (auto task = tq_->try_poll()) {
+        return task;
+    }
+    const size_type queue_cnt = local_queues_.size();
+    for (size_type i = 0; i < queue_cnt; ++i) {
+        if (victim != index) {
+            if (auto slot = local_queues_[victim]->steal()) {
+#if DTS_THREAD_POOL_STATS
+                detail::worker_counters::add<std::uint64_t>(
+                  this_worker.counters->tasks_stolen, 1);
+#endif
+                return take_task_slot(*slot);
+            }
+        }
+        victim = (victim + 1) % queue_cnt;
     }
+    return std::nullopt;
+}
+
+bool thread_pool::has_pending_task() {
+    for (const auto& local_queue : local_queues_) {
+        if (!local_queue->empty()) {
+            return true;
+        }
+    }
+    return !tq_->empty();
+}
+
+bool thread_pool::claim_retirement() noexcept {
+    size_type cnt = retire_cnt_.load(std::memory_order_relaxed);
+    while (cnt != 0) {
+        if (retire_cnt_.compare_exchange_weak(cnt, cnt - 1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool thread_pool::park_worker() {
+    auto ready = [this]() {
+        return stopping_.load() || retire_cnt_.load() != 0 ||
+               has_pending_task();
+    };
+    if (options_.max_workers == 0) {
+        idle_workers_.wait(ready);
+        return true;
+    }
+    return idle_workers_.wait_until(
+      ready, std::chrono::steady_clock::now() + options_.idle_timeout);
+}
+
+void thread_pool::wake_workers(size_type task_cnt) {
+    idle_workers_.notify(task_cnt);
 }
 
 }  // namespace dts
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+/**
+ * Replaces the global operator new and delete with ones that count
+ * allocations, for tests checking that a path doesn't allocate. Must be
+ * included by a single translation unit of a test binary.
+ */
+
+static std::atomic<std::size_t> alloc_cnt(0);
+
+void* operator new(std::size_t size) {
+    ++alloc_cnt;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
@@ -1,8 +1,33 @@
 #include "thread_pool.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <numeric>
 #include <random>
+#include <set>
+#include <stdexcept>
+
+#include "bounded_task_queue.hpp"
+#if defined(__cpp_impl_coroutine)
+#include "coroutine.hpp"
+#endif
+#include "counting_new.hpp"
+#include "cpu_affinity.hpp"
+#include "future_combinators.hpp"
+#include "latency_histogram.hpp"
+#include "mpmc_ring.hpp"
+#include "numa_thread_pool.hpp"
+#include "parallel_algorithm.hpp"
+#include "task_graph.hpp"
+#include "task_queue.hpp"
+#include "work_stealing_deque.hpp"
 
 void test(int iter_cnt, int target) {
     std::cout << "iter_cnt: " << iter_cnt << '\n';
@@ -11,7 +36,7 @@ void test(int iter_cnt, int target) {
     std::mutex mtx;
     for (int k = 1; k <= iter_cnt; ++k) {
         int v = 0;
-        std::vector<std::future<int>> results;
+        std::vector<dts::future<int>> results;
         results.reserve(target);
         dts::thread_pool pool(std::thread::hardware_concurrency());
         for (int i = 0; i < target; ++i) {
@@ -33,11 +58,1321 @@ void test(int iter_cnt, int target) {
     std::cout << '\n';
 }
 
+void test_work_stealing_deque() {
+    std::cout << "test_work_stealing_deque\n";
+    dts::work_stealing_deque<int> deque(2);
+    for (int i = 0; i < 10; ++i) {
+        deque.push(i);
+    }
+    assert(deque.size() == 10);
+    // Owner pops LIFO, thieves steal FIFO.
+    assert(deque.pop() == 9);
+    assert(deque.steal() == 0);
+    assert(deque.size() == 8);
+    while (deque.pop()) {
+    }
+    assert(deque.empty());
+
+    constexpr int item_cnt = 100000;
+    std::vector<std::atomic<int>> seen(item_cnt);
+    std::atomic<bool> done(false);
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < 3; ++i) {
+        thieves.emplace_back([&]() {
+            while (!done.load() || !deque.empty()) {
+                if (auto item = deque.steal()) {
+                    ++seen[*item];
+                }
+            }
+        });
+    }
+    for (int i = 0; i < item_cnt; ++i) {
+        deque.push(i);
+        if (i % 3 == 0) {
+            if (auto item = deque.pop()) {
+                ++seen[*item];
+            }
+        }
+    }
+    while (auto item = deque.pop()) {
+        ++seen[*item];
+    }
+    done.store(true);
+    for (std::thread& thief : thieves) {
+        thief.join();
+    }
+    for (int i = 0; i < item_cnt; ++i) {
+        assert(seen[i] == 1);
+    }
+}
+
+void spawn(dts::thread_pool& pool, std::atomic<int>& cnt, int depth) {
+    ++cnt;
+    if (depth > 0) {
+        pool.submit(spawn, std::ref(pool), std::ref(cnt), depth - 1);
+        pool.submit(spawn, std::ref(pool), std::ref(cnt), depth - 1);
+    }
+}
+
+void test_work_stealing() {
+    std::cout << "test_work_stealing\n";
+    constexpr int depth = 14;
+    std::atomic<int> cnt(0);
+    {
+        dts::thread_pool_options options;
+        options.work_stealing = true;
+        dts::thread_pool pool(std::thread::hardware_concurrency(), options);
+        // Tasks submitted from workers go to local deques.
+        pool.submit(spawn, std::ref(pool), std::ref(cnt), depth);
+        std::vector<dts::future<int>> results;
+        for (int i = 0; i < 1000; ++i) {
+            results.emplace_back(pool.submit([i]() {
+                return i * 2;
+            }));
+        }
+        for (int i = 0; i < 1000; ++i) {
+            assert(results[i].get() == i * 2);
+        }
+        // The destructor drains every deque.
+    }
+    assert(cnt == (1 << (depth + 1)) - 1);
+}
+
+void test_unique_task() {
+    std::cout << "test_unique_task\n";
+    int n = 0;
+    dts::unique_task small([&n]() {
+        ++n;
+    });
+    dts::unique_task moved(std::move(small));
+    assert(!small && moved);
+    moved();
+    assert(n == 1);
+
+    // Too big for the inline storage, falls back to the heap.
+    std::array<char, 2 * dts::unique_task::inline_size> big{};
+    const std::size_t before = alloc_cnt;
+    dts::unique_task large([big, &n]() {
+        n += big.size();
+    });
+    assert(alloc_cnt == before + 1);
+    small = std::move(large);
+    small();
+    assert(n == 1 + static_cast<int>(big.size()));
+
+    // The callable is reachable by its type, inline or not.
+    struct counter {
+        void operator()() {
+            ++cnt;
+        }
+        int cnt = 0;
+    };
+    dts::unique_task counting(counter{});
+    counting();
+    assert(counting.target<counter>() != nullptr &&
+           counting.target<counter>()->cnt == 1);
+    assert(small.target<counter>() == nullptr);
+    assert(dts::unique_task().target<counter>() == nullptr);
+}
+
+void test_future() {
+    std::cout << "test_future\n";
+    dts::thread_pool pool(2);
+    auto value = pool.submit([](int a, int b) {
+        return a + b;
+    }, 1, 2);
+    assert(value.get() == 3 && !value.valid());
+
+    int n = 0;
+    auto ref = pool.submit([](int& m) -> int& {
+        return ++m;
+    }, std::ref(n));
+    assert(&ref.get() == &n && n == 1);
+
+    auto error = pool.submit([]() {
+        throw std::runtime_error("error");
+    });
+    bool caught = false;
+    try {
+        error.get();
+    } catch (std::runtime_error&) {
+        caught = true;
+    }
+    assert(caught);
+
+    dts::future<void> broken;
+    {
+        dts::promise<void> prom;
+        broken = prom.get_future();
+    }
+    try {
+        broken.get();
+        assert(false);
+    } catch (std::future_error& e) {
+        assert(e.code() == std::future_errc::broken_promise);
+    }
+}
+
+void test_allocation_free_submit() {
+    std::cout << "test_allocation_free_submit\n";
+    constexpr int batch = 256;
+    std::vector<dts::thread_pool_options> configs(3);
+    configs[1].work_stealing = true;
+    configs[2].queue_capacity = 64;
+    for (const auto& options : configs) {
+        dts::thread_pool pool(2, options);
+        std::vector<dts::future<int>> results(batch);
+        int sum = 0;
+        auto run_batch = [&]() {
+            for (int i = 0; i < batch; ++i) {
+                results[i] = pool.submit([i, &sum]() {
+                    return i + sum * 0;
+                });
+            }
+            for (int i = 0; i < batch; ++i) {
+                assert(results[i].get() == i);
+            }
+        };
+        // Let the task queue and the promise pool grow to their working size.
+        for (int round = 0; round < 8; ++round) {
+            run_batch();
+        }
+        const std::size_t before = alloc_cnt;
+        for (int round = 0; round < 8; ++round) {
+            run_batch();
+        }
+        assert(alloc_cnt == before);
+    }
+}
+
+void test_post() {
+    std::cout << "test_post\n";
+    std::atomic<int> cnt(0);
+    std::atomic<int> error_cnt(0);
+    {
+        dts::thread_pool_options options;
+        options.exception_handler = [&error_cnt](std::exception_ptr error) {
+            try {
+                std::rethrow_exception(error);
+            } catch (std::runtime_error&) {
+                ++error_cnt;
+            }
+        };
+        dts::thread_pool pool(2, options);
+        for (int i = 0; i < 1000; ++i) {
+            pool.post([&cnt]() {
+                ++cnt;
+            });
+            pool.post([](std::atomic<int>& c, int delta) {
+                c += delta;
+            }, std::ref(cnt), 2);
+            if (i % 10 == 0) {
+                pool.post([]() {
+                    throw std::runtime_error("error");
+                });
+            }
+        }
+    }
+    assert(cnt == 3000);
+    assert(error_cnt == 100);
+}
+
+void test_bulk() {
+    std::cout << "test_bulk\n";
+    std::vector<int> shards(10000);
+    std::iota(shards.begin(), shards.end(), 0);
+    for (bool work_stealing : { false, true }) {
+        dts::thread_pool_options options;
+        options.work_stealing = work_stealing;
+        dts::thread_pool pool(4, options);
+
+        auto results =
+          pool.submit_bulk(shards.begin(), shards.end(), [](int shard) {
+              return shard * 2;
+          });
+        assert(results.size() == shards.size());
+        for (int i = 0; i < static_cast<int>(results.size()); ++i) {
+            assert(results[i].get() == i * 2);
+        }
+
+        std::atomic<long> sum(0);
+        pool
+          .post_bulk(shards.begin(), shards.end(),
+                     [&sum](int shard) {
+                         sum += shard;
+                     })
+          .get();
+        assert(sum == 10000L * 9999 / 2);
+
+        // Bulk submission from inside a worker.
+        pool
+          .submit([&pool, &shards, &sum]() {
+              return pool.post_bulk(shards.begin(), shards.end(),
+                                    [&sum](int shard) {
+                                        sum -= shard;
+                                    });
+          })
+          .get()
+          .get();
+        assert(sum == 0);
+
+        auto failed =
+          pool.post_bulk(shards.begin(), shards.end(), [](int shard) {
+              if (shard % 1000 == 0) {
+                  throw std::runtime_error("error");
+              }
+          });
+        bool caught = false;
+        try {
+            failed.get();
+        } catch (std::runtime_error&) {
+            caught = true;
+        }
+        assert(caught);
+
+        auto none = pool.post_bulk(shards.end(), shards.end(), [](int) {});
+        assert(none.is_ready());
+    }
+}
+
+void test_parallel_algorithm() {
+    std::cout << "test_parallel_algorithm\n";
+    dts::thread_pool pool(4);
+    constexpr int n = 100000;
+
+    std::vector<std::atomic<int>> hits(n);
+    dts::parallel_for(pool, 0, n, 64, [&hits](int i) {
+        ++hits[i];
+    });
+    for (int i = 0; i < n; ++i) {
+        assert(hits[i] == 1);
+    }
+
+    std::vector<long> values(n);
+    std::iota(values.begin(), values.end(), 1L);
+    dts::parallel_for(pool, values.begin(), values.end(), [](long& v) {
+        v *= 2;
+    });
+    assert(values.back() == 2L * n);
+
+    const long sum = dts::parallel_reduce(pool, values.begin(), values.end(),
+                                          128, 0L, std::plus<>());
+    assert(sum == static_cast<long>(n) * (n + 1));
+    const long squares = dts::parallel_reduce(
+      pool, 0L, 1000L, 16, 0L, std::plus<>(), [](long i) {
+          return i * i;
+      });
+    assert(squares == 999L * 1000 * 1999 / 6);
+    assert(dts::parallel_reduce(pool, 0, 0, 1, 42, std::plus<>()) == 42);
+
+    std::vector<long> halves(n);
+    auto out_end = dts::parallel_transform(
+      pool, values.begin(), values.end(), halves.begin(), 256, [](long v) {
+          return v / 2;
+      });
+    assert(out_end == halves.end());
+    for (int i = 0; i < n; ++i) {
+        assert(halves[i] == i + 1);
+    }
+
+    bool caught = false;
+    try {
+        dts::parallel_for(pool, 0, n, 16, [](int i) {
+            if (i == n / 2) {
+                throw std::runtime_error("error");
+            }
+        });
+    } catch (std::runtime_error&) {
+        caught = true;
+    }
+    assert(caught);
+
+    // Nested calls from workers complete even though every worker waits.
+    std::atomic<int> nested(0);
+    dts::parallel_for(pool, 0, 8, [&pool, &nested](int) {
+        dts::parallel_for(pool, 0, 1000, 10, [&nested](int) {
+            ++nested;
+        });
+    });
+    assert(nested == 8000);
+}
+
+void test_mpmc_ring() {
+    std::cout << "test_mpmc_ring\n";
+    dts::mpmc_ring<int> ring(3);
+    assert(ring.capacity() == 4);
+    for (int i = 0; i < 4; ++i) {
+        assert(ring.try_push(std::move(i)));
+    }
+    int extra = 4;
+    assert(!ring.try_push(std::move(extra)));
+    assert(ring.try_pop() == 0 && ring.size() == 3);
+
+    dts::mpmc_ring<int> shared(64);
+    constexpr int per_producer = 50000;
+    std::atomic<long> sum(0);
+    std::atomic<int> popped(0);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < 2; ++p) {
+        threads.emplace_back([&shared]() {
+            for (int i = 1; i <= per_producer; ++i) {
+                int item = i;
+                while (!shared.try_push(std::move(item))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        threads.emplace_back([&]() {
+            while (popped < 2 * per_producer) {
+                if (auto item = shared.try_pop()) {
+                    sum += *item;
+                    ++popped;
+                }
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    assert(sum == 2L * per_producer * (per_producer + 1) / 2);
+}
+
+void test_bounded_queue() {
+    std::cout << "test_bounded_queue\n";
+    for (auto overflow :
+         { dts::overflow_policy::block, dts::overflow_policy::spin }) {
+        dts::thread_pool_options options;
+        options.queue_capacity = 4;
+        options.overflow = overflow;
+        std::atomic<int> cnt(0);
+        {
+            dts::thread_pool pool(2, options);
+            for (int i = 0; i < 10000; ++i) {
+                pool.post([&cnt]() {
+                    ++cnt;
+                });
+            }
+            std::vector<int> items(1000);
+            pool.post_bulk(items.begin(), items.end(), [&cnt](int) {
+                ++cnt;
+            });
+        }
+        assert(cnt == 11000);
+    }
+
+    // One worker held on a gate and a full queue behind it.
+    auto fill = [](dts::thread_pool& pool, std::atomic<bool>& gate) {
+        std::atomic<bool> started(false);
+        pool.post([&gate, &started]() {
+            started = true;
+            while (!gate) {
+                std::this_thread::yield();
+            }
+        });
+        while (!started) {
+            std::this_thread::yield();
+        }
+        for (int i = 0; i < 4; ++i) {
+            pool.post([]() {});
+        }
+    };
+
+    dts::thread_pool_options options;
+    options.queue_capacity = 4;
+    options.overflow = dts::overflow_policy::reject;
+    {
+        std::atomic<bool> gate(false);
+        dts::thread_pool pool(1, options);
+        fill(pool, gate);
+        bool rejected = false;
+        try {
+            pool.post([]() {});
+        } catch (dts::thread_pool_overloaded&) {
+            rejected = true;
+        }
+        assert(rejected);
+        gate = true;
+    }
+
+    options.overflow = dts::overflow_policy::run_in_caller;
+    {
+        std::atomic<bool> gate(false);
+        dts::thread_pool pool(1, options);
+        fill(pool, gate);
+        auto where = pool.submit([]() {
+            return std::this_thread::get_id();
+        });
+        assert(where.is_ready());
+        assert(where.get() == std::this_thread::get_id());
+        gate = true;
+    }
+
+    // A worker finding the queue full runs the task instead of waiting.
+    for (auto overflow :
+         { dts::overflow_policy::block, dts::overflow_policy::spin }) {
+        options.overflow = overflow;
+        dts::thread_pool pool(1, options);
+        std::atomic<int> cnt(0);
+        pool.submit([&pool, &cnt]() {
+                for (int i = 0; i < 100; ++i) {
+                    pool.post([&cnt]() {
+                        ++cnt;
+                    });
+                }
+                std::vector<int> items(100);
+                pool.post_bulk(items.begin(), items.end(), [&cnt](int) {
+                    ++cnt;
+                });
+            })
+          .get();
+        pool.wait_idle();
+        assert(cnt == 200);
+    }
+}
+
+void test_idle_spin() {
+    std::cout << "test_idle_spin\n";
+    for (bool work_stealing : { false, true }) {
+        for (bool adaptive : { false, true }) {
+            dts::thread_pool_options options;
+            options.work_stealing = work_stealing;
+            options.spin_count = 256;
+            options.yield_count = 16;
+            options.adaptive_spin = adaptive;
+            std::atomic<int> cnt(0);
+            {
+                dts::thread_pool pool(3, options);
+                // Bursts with gaps so that workers go through every phase.
+                for (int burst = 0; burst < 20; ++burst) {
+                    std::vector<dts::future<void>> futures;
+                    for (int i = 0; i < 50; ++i) {
+                        futures.push_back(pool.submit([&cnt]() {
+                            ++cnt;
+                        }));
+                    }
+                    for (auto& fut : futures) {
+                        fut.get();
+                    }
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+                for (int i = 0; i < 1000; ++i) {
+                    pool.post([&cnt]() {
+                        ++cnt;
+                    });
+                }
+            }
+            assert(cnt == 2000);
+        }
+    }
+}
+
+void test_priority() {
+    std::cout << "test_priority\n";
+    using dts::task_priority;
+
+    auto check_queue = [](dts::basic_task_queue& tq) {
+        std::vector<int> order;
+        auto push = [&tq, &order](int id, task_priority priority) {
+            tq.push(dts::unique_task([&order, id]() {
+                        order.push_back(id);
+                    }),
+                    priority);
+        };
+        auto drain = [&tq, &order]() {
+            order.clear();
+            while (auto task = tq.try_poll()) {
+                (*task)();
+            }
+            return order;
+        };
+
+        push(0, task_priority::low);
+        push(1, task_priority::normal);
+        push(2, task_priority::high);
+        push(3, task_priority::normal);
+        assert(!tq.empty(task_priority::high));
+        assert((drain() == std::vector<int>{ 2, 1, 3, 0 }));
+        assert(tq.empty(task_priority::high));
+
+        // The starvation limit is 4.
+        push(100, task_priority::low);
+        for (int i = 0; i < 10; ++i) {
+            push(i, task_priority::high);
+        }
+        assert((drain() ==
+                std::vector<int>{ 0, 1, 2, 3, 100, 4, 5, 6, 7, 8, 9 }));
+    };
+    {
+        dts::task_queue tq(4);
+        check_queue(tq);
+    }
+    {
+        dts::bounded_task_queue tq(64, dts::overflow_policy::block, 4);
+        // Every lane has room for 64 tasks.
+        assert(tq.lane_capacity() == 64);
+        assert(tq.capacity() == 64 * dts::task_priority_count);
+        check_queue(tq);
+    }
+
+    dts::thread_pool_options stealing;
+    stealing.work_stealing = true;
+    dts::thread_pool_options bounded;
+    bounded.queue_capacity = 64;
+    for (const auto& options :
+         { dts::thread_pool_options(), stealing, bounded }) {
+        std::vector<task_priority> order;
+        std::atomic<bool> gate(false);
+        {
+            dts::thread_pool pool(1, options);
+            pool.post([&gate]() {
+                while (!gate) {
+                    std::this_thread::yield();
+                }
+            });
+            for (auto priority : { task_priority::low, task_priority::normal,
+                                   task_priority::high }) {
+                for (int i = 0; i < 3; ++i) {
+                    pool.post(priority, [&order, priority]() {
+                        order.push_back(priority);
+                    });
+                }
+            }
+            auto fut = pool.submit(task_priority::high, [](int x) {
+                return x * 2;
+            }, 21);
+            gate = true;
+            assert(fut.get() == 42);
+        }
+        assert(std::is_sorted(order.begin(), order.end()));
+    }
+
+    // Prioritized tasks from a worker bypass its local deque.
+    std::vector<int> order;
+    {
+        dts::thread_pool pool(1, stealing);
+        std::vector<dts::future<void>> futures;
+        pool.submit([&pool, &order, &futures]() {
+                for (int i = 1; i <= 3; ++i) {
+                    futures.push_back(pool.submit([&order, i]() {
+                        order.push_back(i);
+                    }));
+                }
+                futures.push_back(pool.submit(task_priority::high, [&order]() {
+                    order.push_back(0);
+                }));
+            })
+          .get();
+        for (auto& fut : futures) {
+            fut.get();
+        }
+    }
+    // The owner pops its deque LIFO.
+    assert((order == std::vector<int>{ 0, 3, 2, 1 }));
+}
+
+void test_shutdown() {
+    std::cout << "test_shutdown\n";
+    dts::thread_pool_options stealing;
+    stealing.work_stealing = true;
+    dts::thread_pool_options bounded;
+    bounded.queue_capacity = 256;
+    const std::vector<dts::thread_pool_options> configs{
+        dts::thread_pool_options(), stealing, bounded
+    };
+
+    for (const auto& options : configs) {
+        std::atomic<int> cnt(0);
+        dts::thread_pool pool(2, options);
+        for (int i = 0; i < 1000; ++i) {
+            pool.post([&cnt]() {
+                ++cnt;
+            });
+        }
+        pool.shutdown();
+        assert(cnt == 1000);
+        bool stopped = false;
+        try {
+            pool.post([]() {});
+        } catch (dts::thread_pool_stopped&) {
+            stopped = true;
+        }
+        assert(stopped);
+        pool.shutdown();
+        assert(pool.shutdown_now() == 0);
+    }
+
+    for (const auto& options : configs) {
+        std::atomic<int> cnt(0);
+        std::atomic<bool> started(false);
+        std::atomic<bool> gate(false);
+        dts::thread_pool pool(1, options);
+        pool.post([&started, &gate]() {
+            started = true;
+            while (!gate) {
+                std::this_thread::yield();
+            }
+        });
+        while (!started) {
+            std::this_thread::yield();
+        }
+        std::vector<dts::future<void>> futures;
+        for (int i = 0; i < 100; ++i) {
+            futures.push_back(pool.submit([&cnt]() {
+                ++cnt;
+            }));
+            pool.post([&cnt]() {
+                ++cnt;
+            });
+        }
+        std::vector<int> items(10);
+        auto batch = pool.post_bulk(items.begin(), items.end(), [&cnt](int) {
+            ++cnt;
+        });
+        std::thread opener([&gate]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            gate = true;
+        });
+        assert(pool.shutdown_now() == 210);
+        opener.join();
+        assert(cnt == 0);
+        for (auto& fut : futures) {
+            bool stopped = false;
+            try {
+                fut.get();
+            } catch (dts::thread_pool_stopped&) {
+                stopped = true;
+            }
+            assert(stopped);
+        }
+        bool stopped = false;
+        try {
+            batch.get();
+        } catch (dts::thread_pool_stopped&) {
+            stopped = true;
+        }
+        assert(stopped);
+    }
+
+    // Every task a producer gets in while the pool stops runs.
+    dts::thread_pool_options stealing_bounded = bounded;
+    stealing_bounded.work_stealing = true;
+    for (const auto& options : { bounded, stealing_bounded }) {
+        for (int round = 0; round < 50; ++round) {
+            std::atomic<int> cnt(0);
+            std::atomic<int> accepted(0);
+            dts::thread_pool pool(2, options);
+            std::vector<std::thread> producers;
+            for (int i = 0; i < 2; ++i) {
+                producers.emplace_back([&pool, &cnt, &accepted]() {
+                    try {
+                        while (true) {
+                            pool.post([&cnt]() {
+                                ++cnt;
+                            });
+                            ++accepted;
+                        }
+                    } catch (dts::thread_pool_stopped&) {
+                    }
+                });
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            pool.shutdown();
+            for (auto& producer : producers) {
+                producer.join();
+            }
+            assert(cnt == accepted);
+        }
+    }
+
+    dts::thread_pool_options in_caller;
+    in_caller.queue_capacity = 4;
+    in_caller.overflow = dts::overflow_policy::run_in_caller;
+    auto all_configs = configs;
+    all_configs.push_back(in_caller);
+    // Under block, workers fill it as well, and must not wait for room that
+    // only workers make.
+    dts::thread_pool_options small;
+    small.queue_capacity = 4;
+    all_configs.push_back(small);
+    for (const auto& options : all_configs) {
+        std::atomic<int> cnt(0);
+        dts::thread_pool pool(3, options);
+        pool.wait_idle();
+        for (int round = 1; round <= 3; ++round) {
+            for (int i = 0; i < 300; ++i) {
+                pool.post([&pool, &cnt]() {
+                    ++cnt;
+                    pool.post([&cnt]() {
+                        ++cnt;
+                    });
+                });
+            }
+            std::vector<int> items(100);
+            pool.post_bulk(items.begin(), items.end(), [&cnt](int) {
+                ++cnt;
+            });
+            pool.wait_idle();
+            assert(cnt == round * 700);
+        }
+    }
+}
+
+// Occupies cnt workers at once, which only works if the pool has as many.
+void occupy_workers(dts::thread_pool& pool, int cnt) {
+    std::atomic<int> arrived(0);
+    std::vector<dts::future<bool>> futures;
+    for (int i = 0; i < cnt; ++i) {
+        futures.push_back(pool.submit([&arrived, cnt]() {
+            ++arrived;
+            const auto deadline =
+              std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            while (arrived < cnt) {
+                if (std::chrono::steady_clock::now() > deadline) {
+                    return false;
+                }
+                std::this_thread::yield();
+            }
+            return true;
+        }));
+    }
+    for (auto& fut : futures) {
+        assert(fut.get());
+    }
+}
+
+void test_resize() {
+    std::cout << "test_resize\n";
+    dts::thread_pool_options stealing;
+    stealing.work_stealing = true;
+    dts::thread_pool_options bounded;
+    bounded.queue_capacity = 64;
+
+    for (const auto& options :
+         { dts::thread_pool_options(), stealing, bounded }) {
+        dts::thread_pool pool(6, options);
+        pool.resize(2);
+        assert(pool.worker_count() == 2);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        std::mutex mtx;
+        std::set<std::thread::id> ids;
+        for (int i = 0; i < 200; ++i) {
+            pool.post([&mtx, &ids]() {
+                std::lock_guard<std::mutex> lkgrd(mtx);
+                ids.insert(std::this_thread::get_id());
+            });
+        }
+        pool.wait_idle();
+        assert(ids.size() <= 2);
+
+        pool.resize(6);
+        assert(pool.worker_count() == 6);
+        occupy_workers(pool, 6);
+        pool.resize(0);
+        pool.resize(3);
+        occupy_workers(pool, 3);
+        if (options.work_stealing) {
+            bool thrown = false;
+            try {
+                pool.resize(7);
+            } catch (std::invalid_argument&) {
+                thrown = true;
+            }
+            assert(thrown);
+        }
+        pool.shutdown();
+        bool stopped = false;
+        try {
+            pool.resize(1);
+        } catch (dts::thread_pool_stopped&) {
+            stopped = true;
+        }
+        assert(stopped);
+    }
+
+    for (bool work_stealing : { false, true }) {
+        dts::thread_pool_options elastic;
+        elastic.work_stealing = work_stealing;
+        elastic.min_workers = 1;
+        elastic.max_workers = 4;
+        elastic.idle_timeout = std::chrono::milliseconds(20);
+        dts::thread_pool pool(0, elastic);
+        assert(pool.worker_count() == 1);
+        occupy_workers(pool, 4);
+        assert(pool.worker_count() == 4);
+        const auto deadline =
+          std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (pool.worker_count() != 1 &&
+               std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        assert(pool.worker_count() == 1);
+        std::atomic<int> cnt(0);
+        for (int i = 0; i < 1000; ++i) {
+            pool.post([&cnt]() {
+                ++cnt;
+            });
+        }
+        pool.wait_idle();
+        assert(cnt == 1000);
+    }
+
+    // Down to no workers at all, then back up on demand.
+    dts::thread_pool_options elastic;
+    elastic.max_workers = 2;
+    elastic.idle_timeout = std::chrono::milliseconds(1);
+    dts::thread_pool pool(1, elastic);
+    for (int i = 0; i < 100; ++i) {
+        pool.submit([]() {}).get();
+        if (i % 10 == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+}
+
+void test_affinity() {
+    std::cout << "test_affinity\n";
+    assert((dts::parse_cpu_list("0-3, 8,10-11\n") ==
+            std::vector<int>{ 0, 1, 2, 3, 8, 10, 11 }));
+    assert(dts::parse_cpu_list("").empty());
+
+    const std::vector<int> allowed = dts::allowed_cpus();
+    assert(!allowed.empty());
+    const int cpu = allowed.back();
+    for (bool one_per_worker : { false, true }) {
+        dts::thread_pool_options options;
+        options.cpu_affinity = { cpu };
+        options.pin_one_cpu_per_worker = one_per_worker;
+        dts::thread_pool pool(2, options);
+        for (int i = 0; i < 10; ++i) {
+            assert(pool.submit(dts::current_cpu).get() == cpu);
+        }
+        assert(pool.stats().pin_failures == 0);
+    }
+    dts::thread_pool_options bad;
+    bad.cpu_affinity = { -1 };
+    bool thrown = false;
+    try {
+        dts::thread_pool pool(1, bad);
+    } catch (std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // A fake sysfs tree.
+    namespace fs = std::filesystem;
+    const fs::path root = fs::temp_directory_path() / "dts_numa_test";
+    fs::remove_all(root);
+    auto add_node = [&root](const std::string& name, const std::string& cpus) {
+        fs::create_directories(root / name);
+        std::ofstream(root / name / "cpulist") << cpus << '\n';
+    };
+    add_node("node0", std::to_string(cpu));
+    add_node("node1", "");
+    add_node("node2", "100000");
+    add_node("power", "0");
+    auto nodes = dts::numa_nodes(root.string());
+    assert(nodes.size() == 1);
+    assert(nodes[0].id == 0 && nodes[0].cpus == std::vector<int>{ cpu });
+    fs::remove_all(root);
+    nodes = dts::numa_nodes(root.string());
+    assert(nodes.size() == 1 && nodes[0].cpus == allowed);
+
+    {
+        dts::numa_thread_pool pool(2);
+        assert(pool.node_count() >= 1);
+        assert(pool.local_node() < pool.node_count());
+        for (std::size_t i = 0; i < pool.node_count(); ++i) {
+            const auto& node_cpus = pool.node(i).cpus;
+            const int ran_on = pool.submit_on(i, dts::current_cpu).get();
+            assert(std::find(node_cpus.begin(), node_cpus.end(), ran_on) !=
+                   node_cpus.end());
+        }
+    }
+
+    // Two nodes sharing a CPU, to exercise routing on any machine.
+    dts::numa_thread_pool pool(
+      1, dts::thread_pool_options(),
+      { dts::numa_node{ 0, { cpu } }, dts::numa_node{ 1, { cpu } } });
+    assert(pool.node_count() == 2);
+    std::atomic<int> cnt(0);
+    auto on_node1 = pool.submit_on(1, [&pool, &cnt]() {
+        ++cnt;
+        // Submitted from a worker, so it stays local.
+        return pool.submit([&cnt]() {
+            ++cnt;
+        });
+    });
+    on_node1.get().get();
+    pool.post_on(0, dts::task_priority::high, [&cnt]() {
+        ++cnt;
+    });
+    pool.wait_idle();
+    assert(cnt == 3);
+}
+
+void test_continuations() {
+    std::cout << "test_continuations\n";
+    for (bool stealing : { false, true }) {
+        dts::thread_pool_options options;
+        options.work_stealing = stealing;
+        // One worker: a stage waiting on another would deadlock.
+        dts::thread_pool pool(1, options);
+        auto f = pool.submit([]() {
+            return 1;
+        });
+        for (int i = 0; i < 100; ++i) {
+            f = f.then([](dts::future<int> prev) {
+                return prev.get() + 1;
+            });
+            assert(f.bound_executor() == &pool);
+        }
+        assert(f.get() == 101);
+
+        auto failed = pool.submit([]() -> int {
+            throw std::runtime_error("failed");
+        });
+        failed = failed.then([](dts::future<int> prev) {
+            return prev.get();
+        });
+        bool thrown = false;
+        try {
+            failed.get();
+        } catch (std::runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        std::vector<dts::future<int>> futures;
+        for (int i = 0; i < 20; ++i) {
+            futures.push_back(pool.submit([i]() {
+                return i;
+            }));
+        }
+        auto sum =
+          dts::when_all(futures.begin(), futures.end())
+            .then([](dts::future<std::vector<dts::future<int>>> all) {
+                int total = 0;
+                for (auto& f : all.get()) {
+                    total += f.get();
+                }
+                return total;
+            });
+        assert(sum.get() == 190);
+
+        auto two = pool.submit([]() {
+            return 2;
+        });
+        auto two_str = pool.submit([]() {
+            return std::string("two");
+        });
+        std::tie(two, two_str) =
+          dts::when_all(std::move(two), std::move(two_str)).get();
+        assert(two.get() == 2 && two_str.get() == "two");
+
+        dts::promise<int> never;
+        std::vector<dts::future<int>> racers;
+        racers.push_back(never.get_future());
+        racers.push_back(pool.submit([]() {
+            return 7;
+        }));
+        auto any = dts::when_any(racers.begin(), racers.end()).get();
+        assert(any.index == 1 && any.futures[1].get() == 7);
+        assert(!any.futures[0].is_ready());
+        never.set_value(0);
+        assert(any.futures[0].get() == 0);
+
+        auto any_tuple = dts::when_any(pool.submit([]() {})).get();
+        assert(any_tuple.index == 0);
+        assert(dts::when_any(racers.begin(), racers.begin()).get().index ==
+               static_cast<std::size_t>(-1));
+        assert(dts::when_all(racers.begin(), racers.begin()).get().empty());
+    }
+
+    // Without an executor, continuations run inline.
+    dts::promise<int> prom;
+    const auto caller = std::this_thread::get_id();
+    auto inline_f = prom.get_future().then([caller](dts::future<int> f) {
+        assert(std::this_thread::get_id() == caller);
+        return f.get() * 2;
+    });
+    assert(!inline_f.is_ready());
+    prom.set_value(21);
+    assert(inline_f.get() == 42);
+
+    dts::thread_pool pool(1);
+    dts::promise<void> gate;
+    auto dropped = gate.get_future().then(pool, [](dts::future<void>) {});
+    pool.shutdown();
+    gate.set_value();
+    bool thrown = false;
+    try {
+        dropped.get();
+    } catch (dts::thread_pool_stopped&) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+void test_task_graph() {
+    std::cout << "test_task_graph\n";
+    for (bool stealing : { false, true }) {
+        dts::thread_pool_options options;
+        options.work_stealing = stealing;
+        dts::thread_pool pool(2, options);
+
+        // A diamond followed by a long chain and a wide fan-out.
+        dts::task_graph graph;
+        std::vector<std::atomic<int>> order(1 + 2 + 1 + 200 + 100);
+        std::atomic<int> clock(0);
+        auto stamp = [&order, &clock](std::size_t id) {
+            return [&order, &clock, id]() {
+                order[id] = ++clock;
+            };
+        };
+        std::vector<dts::task_graph::node_id> ids;
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            ids.push_back(graph.emplace(stamp(i)));
+        }
+        graph.precede(ids[0], ids[1]);
+        graph.precede(ids[0], ids[2]);
+        graph.precede(ids[1], ids[3]);
+        graph.precede(ids[2], ids[3]);
+        for (std::size_t i = 3; i < 203; ++i) {
+            graph.precede(ids[i], ids[i + 1]);
+        }
+        for (std::size_t i = 204; i < order.size(); ++i) {
+            graph.precede(ids[203], ids[i]);
+        }
+        for (int run = 0; run < 3; ++run) {
+            clock = 0;
+            graph.run(pool).get();
+            assert(clock == static_cast<int>(order.size()));
+            assert(order[0] < order[1] && order[0] < order[2]);
+            assert(order[1] < order[3] && order[2] < order[3]);
+            for (std::size_t i = 4; i < order.size(); ++i) {
+                assert(order[i] > order[i < 204 ? i - 1 : 203]);
+            }
+        }
+
+        dts::task_graph failing;
+        std::atomic<int> ran(0);
+        auto a = failing.emplace([]() {
+            throw std::runtime_error("failed");
+        });
+        auto b = failing.emplace([&ran]() {
+            ++ran;
+        });
+        failing.precede(a, b);
+        bool thrown = false;
+        try {
+            failing.run(pool).get();
+        } catch (std::runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown && ran == 0);
+
+        failing.precede(b, a);
+        thrown = false;
+        try {
+            failing.run(pool);
+        } catch (std::invalid_argument&) {
+            thrown = true;
+        }
+        assert(thrown);
+        assert(dts::task_graph().run(pool).is_ready());
+    }
+
+    dts::thread_pool pool(1);
+    pool.shutdown();
+    dts::task_graph graph;
+    std::atomic<int> ran(0);
+    graph.emplace([&ran]() {
+        ++ran;
+    });
+    bool thrown = false;
+    try {
+        graph.run(pool).get();
+    } catch (dts::thread_pool_stopped&) {
+        thrown = true;
+    }
+    assert(thrown && ran == 0);
+}
+
+void test_stats() {
+    std::cout << "test_stats\n";
+    dts::latency_histogram hist;
+    for (int i = 1; i <= 1000; ++i) {
+        hist.record(std::chrono::nanoseconds(i));
+    }
+    assert(hist.count() == 1000);
+    const auto p50 = hist.percentile(50).count();
+    assert(p50 >= 500 && p50 <= 500 * 9 / 8);
+    assert(hist.max().count() >= 1000 && hist.max().count() <= 1000 * 9 / 8);
+    std::default_random_engine gen(7);
+    std::uniform_int_distribution<std::int64_t> dist(
+      0, std::numeric_limits<std::int64_t>::max());
+    for (int i = 0; i < 1000; ++i) {
+        const std::chrono::nanoseconds dur(dist(gen) >> (i % 63));
+        const auto bucket = dts::latency_histogram::bucket_of(dur);
+        assert(bucket < dts::latency_histogram::bucket_count);
+        const auto upper = dts::latency_histogram::upper_bound_of(bucket);
+        assert(upper >= dur && upper.count() - dur.count() <= dur.count() / 8);
+        assert(dts::latency_histogram::bucket_of(upper) == bucket);
+    }
+
+#if DTS_THREAD_POOL_STATS
+    for (bool stealing : { false, true }) {
+        std::atomic<int> started(0);
+        std::atomic<int> ended(0);
+        dts::thread_pool_options options;
+        options.work_stealing = stealing;
+        options.latency_histograms = true;
+        options.on_task_start = [&started](std::size_t) {
+            ++started;
+        };
+        options.on_task_end = [&ended](std::size_t,
+                                       std::chrono::nanoseconds run_time) {
+            assert(run_time.count() >= 0);
+            ++ended;
+        };
+        dts::thread_pool pool(2, options);
+        for (int i = 0; i < 20; ++i) {
+            pool.post([]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            });
+        }
+        for (int i = 0; i < 980; ++i) {
+            pool.post([]() {});
+        }
+        pool.wait_idle();
+        auto stats = pool.stats();
+        assert(stats.pending_tasks == 0 && stats.running_tasks == 0);
+        assert(stats.queued_tasks() == 0);
+        assert(stats.workers.size() == 2);
+        assert(stats.workers[0].id != stats.workers[1].id);
+        auto total = stats.total();
+        assert(total.tasks_executed == 1000);
+        assert(started == 1000 && ended == 1000);
+        assert(total.queue_wait.count() == 1000);
+        assert(total.run_time.count() == 1000);
+        assert(total.busy_time >= std::chrono::milliseconds(20));
+        assert(total.run_time.max() >= std::chrono::milliseconds(1));
+
+        pool.resize(1);
+        pool.shutdown();
+        stats = pool.stats();
+        assert(stats.workers.empty());
+        assert(stats.total().tasks_executed == 1000);
+        assert(stats.retired.tasks_executed == 1000);
+    }
+
+    // Without latency_histograms, the histograms stay empty.
+    dts::thread_pool pool(1);
+    pool.submit([]() {}).get();
+    pool.wait_idle();
+    const auto total = pool.stats().total();
+    assert(total.tasks_executed == 1);
+    assert(total.queue_wait.empty() && total.run_time.empty());
+#endif
+}
+
+#if defined(__cpp_impl_coroutine)
+dts::task<int> add_on(dts::thread_pool& pool, int a, int b) {
+    co_await pool.schedule();
+    co_return a + b;
+}
+
+dts::task<int> sum_on(dts::thread_pool& pool, int n,
+                      std::set<std::thread::id>& threads) {
+    int total = 0;
+    for (int i = 0; i < n; ++i) {
+        total += co_await add_on(pool, i, 1);
+        threads.insert(std::this_thread::get_id());
+    }
+    co_return total;
+}
+
+dts::task<void> fail_on(dts::thread_pool& pool) {
+    co_await pool.schedule(dts::task_priority::high);
+    throw std::runtime_error("failed");
+}
+
+void test_coroutines() {
+    std::cout << "test_coroutines\n";
+    for (bool stealing : { false, true }) {
+        dts::thread_pool_options options;
+        options.work_stealing = stealing;
+        // One worker: a coroutine blocking it would deadlock the others.
+        dts::thread_pool pool(1, options);
+        std::set<std::thread::id> threads;
+        assert(dts::sync_wait(sum_on(pool, 100, threads)) == 5050);
+        // Resumed on the worker that finished add_on().
+        assert(threads.size() == 1 &&
+               *threads.begin() != std::this_thread::get_id());
+
+        bool thrown = false;
+        try {
+            dts::sync_wait(fail_on(pool));
+        } catch (std::runtime_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+
+        // Suspended coroutines wait in the queue, not on a thread.
+        std::vector<std::thread> waiters;
+        std::atomic<int> done(0);
+        for (int i = 0; i < 8; ++i) {
+            waiters.emplace_back([&pool, &done, i]() {
+                std::set<std::thread::id> unused;
+                assert(dts::sync_wait(sum_on(pool, i * 10, unused)) ==
+                       i * 10 * (i * 10 + 1) / 2);
+                ++done;
+            });
+        }
+        for (auto& waiter : waiters) {
+            waiter.join();
+        }
+        assert(done == 8);
+    }
+
+    dts::thread_pool pool(1);
+    pool.shutdown();
+    bool thrown = false;
+    try {
+        dts::sync_wait(add_on(pool, 1, 2));
+    } catch (dts::thread_pool_stopped&) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+#endif
+
 int main() {
     unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
     std::default_random_engine generator(seed);
     std::uniform_int_distribution<int> distribution(500, 1000);
     test(distribution(generator), distribution(generator));
+    test_work_stealing_deque();
+    test_work_stealing();
+    test_unique_task();
+    test_future();
+    test_allocation_free_submit();
+    test_post();
+    test_bulk();
+    test_parallel_algorithm();
+    test_mpmc_ring();
+    test_bounded_queue();
+    test_idle_spin();
+    test_priority();
+    test_shutdown();
+    test_resize();
+    test_affinity();
+    test_continuations();
+    test_task_graph();
+    test_stats();
+#if defined(__cpp_impl_coroutine)
+    test_coroutines();
+#endif
 
     return 0;
 }
\ No newline at end of file